@@ -0,0 +1,373 @@
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "autodiff/execution_plan.h"
+#include "autodiff/functions.h"
+#include "autodiff/kernels/transcendental.h"
+#include "autodiff/node.h"
+#include "autodiff/optimizer/memory_planner.h"
+#include "autodiff/optimizer/optimizer.h"
+#include "autodiff/optimizer/passes/common_subexpression_elim.h"
+#include "autodiff/optimizer/passes/constant_folding.h"
+#include "autodiff/optimizer/passes/dead_code_elim.h"
+#include "autodiff/pipeline.h"
+#include "autodiff/serialization.h"
+#include "autodiff/train/optimizers.h"
+#include "autodiff/train/parameters.h"
+#include "graph_shapes.h"
+#include "harness.h"
+
+namespace {
+
+using T = double;
+using GraphCase = bench::shapes::GraphCase<T>;
+using ShapeFn = GraphCase (*)(size_t);
+
+struct Shape {
+    std::string name;
+    ShapeFn build;
+    std::vector<size_t> sizes;
+};
+
+const std::vector<Shape>& shapes() {
+    static const std::vector<Shape> all = {
+        {"deep_chain", &bench::shapes::deep_chain<T>, {64, 512, 4096}},
+        {"wide_sum", &bench::shapes::wide_sum<T>, {64, 1024, 16384}},
+        {"shared_dag", [](size_t layers) { return bench::shapes::shared_dag<T>(layers); }, {4, 8, 12}},
+        {"random_expr", [](size_t ops) { return bench::shapes::random_expression<T>(ops); }, {64, 512, 4096}},
+    };
+    return all;
+}
+
+// Built graph with every variable bound, ready for evaluate/get_gradients.
+GraphCase bound_graph(const Shape& shape, size_t size) {
+    GraphCase graph_case = shape.build(size);
+    graph_case.root->apply_variables(graph_case.bindings);
+    return graph_case;
+}
+
+// Throughput is reported in graph nodes processed per second.
+int64_t nodes_in(const Shape& shape, size_t size) {
+    return bench::shapes::count_nodes(shape.build(size).root);
+}
+
+void construct(bench::State& state, const Shape& shape, size_t size) {
+    const int64_t nodes = nodes_in(shape, size);
+    while (state.keep_running()) {
+        GraphCase graph_case = shape.build(size);
+        bench::do_not_optimize(graph_case.root.get());
+        // Tearing the graph down is not part of construction.
+        state.pause_timing();
+        graph_case = {};
+        state.resume_timing();
+    }
+    state.set_items_processed(state.iterations() * nodes);
+}
+
+void evaluate(bench::State& state, const Shape& shape, size_t size) {
+    GraphCase graph_case = bound_graph(shape, size);
+    while (state.keep_running()) {
+        bench::do_not_optimize(graph_case.root->evaluate());
+    }
+    state.set_items_processed(state.iterations() * bench::shapes::count_nodes(graph_case.root));
+}
+
+void get_gradients(bench::State& state, const Shape& shape, size_t size) {
+    GraphCase graph_case = bound_graph(shape, size);
+    graph_case.root->evaluate();
+    while (state.keep_running()) {
+        graph_case.root->get_gradients();
+        bench::do_not_optimize(graph_case.root->grad());
+    }
+    state.set_items_processed(state.iterations() * bench::shapes::count_nodes(graph_case.root));
+}
+
+// apply_variables turns variables into constants, so every iteration needs a fresh graph.
+void apply_variables(bench::State& state, const Shape& shape, size_t size) {
+    const int64_t nodes = nodes_in(shape, size);
+    while (state.keep_running()) {
+        state.pause_timing();
+        GraphCase graph_case = shape.build(size);
+        state.resume_timing();
+
+        graph_case.root->apply_variables(graph_case.bindings);
+
+        state.pause_timing();
+        graph_case = {};
+        state.resume_timing();
+    }
+    state.set_items_processed(state.iterations() * nodes);
+}
+
+// optimize() lowers, runs the passes on the IR and raises a new graph, so the input graph can
+// be reused across iterations. Tearing down the result is not timed.
+template <template <typename> class... PassT>
+void optimizer_pass(bench::State& state, const Shape& shape, size_t size) {
+    const std::vector<std::shared_ptr<grad::optimizer::Pass<T>>> passes = {
+        std::make_shared<PassT<T>>()...};
+    GraphCase graph_case = bound_graph(shape, size);
+    const int64_t nodes = bench::shapes::count_nodes(graph_case.root);
+
+    while (state.keep_running()) {
+        auto optimized = grad::optimizer::optimize(graph_case.root, passes);
+        bench::do_not_optimize(optimized.get());
+
+        state.pause_timing();
+        optimized = nullptr;
+        state.resume_timing();
+    }
+    state.set_items_processed(state.iterations() * nodes);
+}
+
+// Liveness analysis and buffer packing for forward + backward, on an IR lowered once.
+void memory_plan(bench::State& state, const Shape& shape, size_t size) {
+    const GraphCase graph_case = bound_graph(shape, size);
+    const auto ir = grad::optimizer::IR<T>::lower(graph_case.root);
+
+    while (state.keep_running()) {
+        const auto plan = grad::optimizer::plan_memory(ir);
+        bench::do_not_optimize(plan.buffer_count);
+    }
+    state.set_items_processed(state.iterations() * static_cast<int64_t>(ir.size()));
+}
+
+/**
+Lowering plus folding, CSE and DCE on the IR alone, without raising back to Nodes, on a graph
+of ~4M nodes. Variables are left unbound so the passes have live values to work through.
+*/
+constexpr size_t kIRSumWidth = 1 << 20;
+
+void ir_pipeline(bench::State& state) {
+    const GraphCase graph_case = bench::shapes::wide_sum<T>(kIRSumWidth);
+    const int64_t nodes = bench::shapes::count_nodes(graph_case.root);
+    grad::optimizer::ConstantFoldingPass<T> folding;
+    grad::optimizer::CommonSubexpressionElimPass<T> cse;
+    grad::optimizer::DeadCodeElimPass<T> dce;
+
+    while (state.keep_running()) {
+        auto ir = grad::optimizer::IR<T>::lower(graph_case.root);
+        folding.apply_pass(ir);
+        cse.apply_pass(ir);
+        dce.apply_pass(ir);
+        bench::do_not_optimize(ir.live_count());
+    }
+    state.set_items_processed(state.iterations() * nodes);
+}
+
+/**
+Streaming pipeline over a CSV file against evaluating the same rows from memory, to check
+that parsing/writing overlaps with compute rather than dominating it.
+*/
+constexpr size_t kPipelineRows = 1 << 16;
+constexpr size_t kPipelineOps = 512;
+
+// One column per random_expression variable.
+std::string pipeline_input(size_t num_columns) {
+    const std::string path = "autodiff_bench_pipeline_input.csv";
+    std::ofstream out{path};
+    out << std::setprecision(17);
+    for (size_t row = 0; row < kPipelineRows; ++row) {
+        for (size_t c = 0; c < num_columns; ++c) {
+            out << 0.001 * static_cast<double>((row + c) % 1000) << (c + 1 == num_columns ? "\n" : ",");
+        }
+    }
+    return path;
+}
+
+void pipeline_csv(bench::State& state, bool with_gradients) {
+    const std::vector<std::byte> bytes =
+        grad::serialization::serialize(bench::shapes::random_expression<T>(kPipelineOps).root);
+    const grad::serialization::GraphView<T> view{bytes};
+
+    std::vector<grad::pipeline::ColumnBinding> bindings;
+    for (size_t i = 0; i < view.variable_count(); ++i) {
+        bindings.push_back({i, i});
+    }
+    const std::string input = pipeline_input(view.variable_count());
+    const std::string output = "autodiff_bench_pipeline_output.csv";
+    grad::pipeline::BatchPipeline<T> pipeline{view, bindings, {.with_gradients = with_gradients}};
+
+    while (state.keep_running()) {
+        grad::pipeline::CsvRowReader<T> reader{input, view.variable_count()};
+        grad::pipeline::CsvRowWriter<T> writer{output};
+        bench::do_not_optimize(pipeline.run(reader, writer));
+    }
+    state.set_items_processed(state.iterations() * kPipelineRows);
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+}
+
+void batch_evaluate(bench::State& state, bool with_gradients) {
+    const std::vector<std::byte> bytes =
+        grad::serialization::serialize(bench::shapes::random_expression<T>(kPipelineOps).root);
+    const grad::serialization::GraphView<T> view{bytes};
+    grad::BatchExecutionPlan<T> plan{view, 256};
+    for (size_t i = 0; i < view.variable_count(); ++i) {
+        std::span<T> lanes = plan.variable_lanes(i);
+        for (size_t l = 0; l < lanes.size(); ++l) {
+            lanes[l] = 0.001 * static_cast<double>((l + i) % 1000);
+        }
+    }
+
+    while (state.keep_running()) {
+        for (size_t row = 0; row < kPipelineRows; row += plan.max_lanes()) {
+            plan.evaluate(plan.max_lanes());
+            if (with_gradients) {
+                plan.backward(plan.max_lanes());
+            }
+        }
+        bench::do_not_optimize(plan.root_values(1)[0]);
+    }
+    state.set_items_processed(state.iterations() * kPipelineRows);
+}
+
+/**
+Array kernels against libm (Accuracy::EXACT is a plain per-element libm loop).
+*/
+constexpr size_t kKernelElements = 4096;
+
+template <typename E>
+using KernelFn = void (*)(const E*, E*, size_t, grad::kernels::Accuracy);
+
+template <typename E>
+void kernel(bench::State& state, KernelFn<E> fn, E lo, E hi, grad::kernels::Accuracy accuracy) {
+    std::vector<E> x(kKernelElements);
+    std::vector<E> y(kKernelElements);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = lo + (hi - lo) * static_cast<E>(i) / static_cast<E>(x.size());
+    }
+    while (state.keep_running()) {
+        fn(x.data(), y.data(), x.size(), accuracy);
+        bench::do_not_optimize(y[0]);
+    }
+    state.set_items_processed(state.iterations() * kKernelElements);
+}
+
+template <typename E>
+void register_kernels(const std::string& type_name) {
+    struct Case {
+        std::string name;
+        KernelFn<E> fn;
+        E lo;
+        E hi;
+    };
+    const std::vector<Case> cases = {
+        {"exp", &grad::kernels::exp<E>, E(-10), E(10)},
+        {"log", &grad::kernels::log<E>, E(1e-3), E(1e3)},
+        {"sin", &grad::kernels::sin<E>, E(-100), E(100)},
+        {"cos", &grad::kernels::cos<E>, E(-100), E(100)},
+        {"tanh", &grad::kernels::tanh<E>, E(-5), E(5)},
+    };
+    for (const Case& c : cases) {
+        for (auto accuracy : {grad::kernels::Accuracy::EXACT, grad::kernels::Accuracy::FAST}) {
+            const std::string mode = accuracy == grad::kernels::Accuracy::FAST ? "fast" : "libm";
+            bench::register_benchmark(
+                "kernel_" + c.name + "/" + type_name + "/" + mode + "/" + std::to_string(kKernelElements),
+                [c, accuracy](bench::State& state) { kernel<E>(state, c.fn, c.lo, c.hi, accuracy); });
+        }
+    }
+}
+
+/**
+Parameter updates after a backward pass: the per-node `set_value(value() - lr * grad())`
+loop user code used to write, against gathering into a ParameterBuffer and stepping. The
+fused numbers include the gather and scatter passes over the nodes.
+*/
+std::vector<grad::ExpressionPtr<T>> trainable_leaves(size_t count) {
+    std::vector<grad::ExpressionPtr<T>> leaves;
+    for (size_t i = 0; i < count; ++i) {
+        leaves.push_back(grad::constant(0.001 * static_cast<T>(i)));
+        leaves.back()->set_grad(0.5);
+    }
+    return leaves;
+}
+
+void per_node_sgd(bench::State& state, size_t count) {
+    const auto leaves = trainable_leaves(count);
+    while (state.keep_running()) {
+        for (const auto& leaf : leaves) leaf->set_value(leaf->value() - 0.01 * leaf->grad());
+    }
+    state.set_items_processed(state.iterations() * count);
+}
+
+template <template <typename> class Optimizer>
+void fused_step(bench::State& state, size_t count) {
+    const auto leaves = trainable_leaves(count);
+    grad::train::ParameterBuffer<T> params{leaves};
+    Optimizer<T> optimizer{};
+    while (state.keep_running()) {
+        params.gather_grads();
+        optimizer.step(params);
+    }
+    state.set_items_processed(state.iterations() * count);
+}
+
+using BenchmarkBody = void (*)(bench::State&, const Shape&, size_t);
+
+void register_all() {
+    const std::vector<std::pair<std::string, BenchmarkBody>> bodies = {
+        {"construct", &construct},
+        {"evaluate", &evaluate},
+        {"get_gradients", &get_gradients},
+        {"apply_variables", &apply_variables},
+        {"constant_folding", &optimizer_pass<grad::optimizer::ConstantFoldingPass>},
+        {"common_subexpression_elim",
+         &optimizer_pass<grad::optimizer::CommonSubexpressionElimPass>},
+        {"dead_code_elim", &optimizer_pass<grad::optimizer::DeadCodeElimPass>},
+        {"optimize_all",
+         &optimizer_pass<grad::optimizer::ConstantFoldingPass, grad::optimizer::CommonSubexpressionElimPass,
+                         grad::optimizer::DeadCodeElimPass>},
+        {"memory_plan", &memory_plan},
+    };
+
+    for (const auto& [body_name, body] : bodies) {
+        for (const Shape& shape : shapes()) {
+            for (size_t size : shape.sizes) {
+                bench::register_benchmark(
+                    body_name + "/" + shape.name + "/" + std::to_string(size),
+                    [body, &shape, size](bench::State& state) { body(state, shape, size); });
+            }
+        }
+    }
+
+    bench::register_benchmark("ir_pipeline/wide_sum/" + std::to_string(kIRSumWidth), &ir_pipeline);
+
+    const std::string rows = std::to_string(kPipelineRows);
+    const std::string graph = "/random_expr/" + std::to_string(kPipelineOps) + "/" + rows;
+    for (bool with_gradients : {false, true}) {
+        const std::string mode = with_gradients ? "_with_gradients" : "";
+        bench::register_benchmark("pipeline_csv" + mode + graph, [with_gradients](bench::State& state) {
+            pipeline_csv(state, with_gradients);
+        });
+        bench::register_benchmark("batch_evaluate" + mode + graph, [with_gradients](bench::State& state) {
+            batch_evaluate(state, with_gradients);
+        });
+    }
+
+    for (size_t count : {1000, 100000}) {
+        const std::string size = "/" + std::to_string(count);
+        const std::vector<std::pair<std::string, void (*)(bench::State&, size_t)>> steps = {
+            {"train_step/sgd_per_node", &per_node_sgd},
+            {"train_step/sgd_fused", &fused_step<grad::train::SGD>},
+            {"train_step/momentum_fused", &fused_step<grad::train::Momentum>},
+            {"train_step/adam_fused", &fused_step<grad::train::Adam>},
+        };
+        for (const auto& [name, body] : steps) {
+            bench::register_benchmark(name + size, [body, count](bench::State& state) { body(state, count); });
+        }
+    }
+
+    register_kernels<float>("float");
+    register_kernels<double>("double");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    register_all();
+    return bench::run_main(argc, argv);
+}
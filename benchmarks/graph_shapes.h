@@ -0,0 +1,167 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "autodiff/functions.h"
+#include "autodiff/graph_helpers.h"
+#include "autodiff/node.h"
+
+/**
+Parameterized graph generators shared by the benchmarks. Every shape is built from
+variables plus constants so that apply_variables and the optimizer passes have work to do.
+*/
+namespace bench::shapes {
+
+template <Numeric T>
+struct GraphCase {
+    grad::ExpressionPtr<T> root;
+    std::unordered_map<std::string, grad::ExpressionPtr<T>> bindings;
+};
+
+inline std::string var_name(size_t i) {
+    return "x" + std::to_string(i);
+}
+
+// Number of distinct nodes reachable from `root`.
+template <Numeric T>
+int64_t count_nodes(const grad::ExpressionPtr<T>& root) {
+    int64_t count = 0;
+    grad::graph::traverse<grad::graph::TraversalType::DFS, grad::ExpressionPtr<T>>(
+        root, [](const grad::ExpressionPtr<T>& node) { return node->get_inputs(); },
+        [&count](const grad::ExpressionPtr<T>&) { ++count; });
+    return count;
+}
+
+/**
+y_0 = x, y_{i+1} = tanh(y_i * c_i + (c_i * c_i)). Depth grows linearly with `depth`, and
+every level has a foldable constant subtree.
+*/
+template <Numeric T>
+GraphCase<T> deep_chain(size_t depth) {
+    GraphCase<T> graph_case;
+    auto x = grad::variable<T>(var_name(0));
+    graph_case.bindings.emplace(var_name(0), grad::constant(static_cast<T>(0.5)));
+
+    grad::ExpressionPtr<T> expr = x;
+    for (size_t i = 0; i < depth; ++i) {
+        const T c = static_cast<T>(0.5 + 0.001 * static_cast<double>(i % 97));
+        expr = grad::tanh(expr * grad::constant(c) + (grad::constant(c) * grad::constant(c)));
+    }
+    graph_case.root = expr;
+    return graph_case;
+}
+
+/**
+sum_i x_i * c_i over `width` variables, reduced pairwise so the tree is wide and shallow.
+*/
+template <Numeric T>
+GraphCase<T> wide_sum(size_t width) {
+    GraphCase<T> graph_case;
+    std::vector<grad::ExpressionPtr<T>> terms;
+    terms.reserve(width);
+    for (size_t i = 0; i < width; ++i) {
+        auto x = grad::variable<T>(var_name(i));
+        graph_case.bindings.emplace(var_name(i),
+                                    grad::constant(static_cast<T>(0.01 * static_cast<double>(i % 100))));
+        terms.push_back(x * grad::constant(static_cast<T>(1.0 + static_cast<double>(i % 7))));
+    }
+
+    while (terms.size() > 1) {
+        std::vector<grad::ExpressionPtr<T>> next;
+        next.reserve((terms.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < terms.size(); i += 2) {
+            next.push_back(terms[i] + terms[i + 1]);
+        }
+        if (terms.size() % 2 == 1) {
+            next.push_back(terms.back());
+        }
+        terms = std::move(next);
+    }
+    graph_case.root = terms.front();
+    return graph_case;
+}
+
+/**
+`layers` layers of `width` nodes where node i of a layer consumes nodes i and i+1 of the
+previous one. Every interior node has two consumers, so a tree walk of this graph is
+exponential in `layers` while the DAG itself only has layers * width nodes.
+*/
+template <Numeric T>
+GraphCase<T> shared_dag(size_t layers, size_t width = 8) {
+    GraphCase<T> graph_case;
+    std::vector<grad::ExpressionPtr<T>> layer;
+    for (size_t i = 0; i < width; ++i) {
+        layer.push_back(grad::variable<T>(var_name(i)));
+        graph_case.bindings.emplace(var_name(i),
+                                    grad::constant(static_cast<T>(0.1 * static_cast<double>(i + 1))));
+    }
+
+    for (size_t l = 0; l < layers; ++l) {
+        std::vector<grad::ExpressionPtr<T>> next;
+        next.reserve(width);
+        for (size_t i = 0; i < width; ++i) {
+            const auto& a = layer[i];
+            const auto& b = layer[(i + 1) % width];
+            next.push_back(l % 2 == 0 ? grad::sin(a * b) : a + b * grad::constant(static_cast<T>(0.5)));
+        }
+        layer = std::move(next);
+    }
+
+    grad::ExpressionPtr<T> root = layer.front();
+    for (size_t i = 1; i < layer.size(); ++i) {
+        root = root + layer[i];
+    }
+    graph_case.root = root;
+    return graph_case;
+}
+
+/**
+Random expression tree with roughly `num_ops` operators over a small pool of variables and
+constants. Deterministic for a given seed.
+*/
+template <Numeric T>
+GraphCase<T> random_expression(size_t num_ops, uint32_t seed = 1234) {
+    constexpr size_t kNumVariables = 16;
+
+    GraphCase<T> graph_case;
+    std::vector<grad::ExpressionPtr<T>> variables;
+    for (size_t i = 0; i < kNumVariables; ++i) {
+        variables.push_back(grad::variable<T>(var_name(i)));
+        graph_case.bindings.emplace(var_name(i),
+                                    grad::constant(static_cast<T>(0.05 * static_cast<double>(i + 1))));
+    }
+
+    std::mt19937 rng{seed};
+
+    auto build = [&](auto& self, size_t ops) -> grad::ExpressionPtr<T> {
+        if (ops == 0) {
+            if (rng() % 4 == 0) {
+                return grad::constant(static_cast<T>(0.25 + 0.01 * static_cast<double>(rng() % 50)));
+            }
+            return variables[rng() % kNumVariables];
+        }
+
+        switch (rng() % 5) {
+            case 0:
+                return grad::sin(self(self, ops - 1));
+            case 1:
+                return grad::tanh(self(self, ops - 1));
+            case 2:
+                return grad::cos(self(self, ops - 1));
+            default: {
+                const size_t left = rng() % ops;
+                auto lhs = self(self, left);
+                auto rhs = self(self, ops - 1 - left);
+                return rng() % 2 == 0 ? lhs + rhs : lhs * rhs;
+            }
+        }
+    };
+
+    graph_case.root = build(build, num_ops);
+    return graph_case;
+}
+
+}  // namespace bench::shapes
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+/**
+Tiny self-contained benchmark harness. Mirrors the parts of Google Benchmark we need
+(calibrated iteration counts, paused timing, items/sec) and writes the same JSON schema,
+so results can be diffed with Google Benchmark's compare.py without needing the library
+(or network access) at build time.
+*/
+namespace bench {
+
+// Keeps the optimizer from discarding a computed value.
+template <typename T>
+inline void do_not_optimize(T&& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class State {
+   public:
+    explicit State(int64_t max_iterations) : max_iterations_{max_iterations} {}
+
+    /**
+    Drives the timed loop:
+        while (state.keep_running()) { ... }
+    */
+    bool keep_running() {
+        if (iterations_ == 0) {
+            resume_timing();
+        }
+        if (iterations_ < max_iterations_) {
+            ++iterations_;
+            return true;
+        }
+        pause_timing();
+        return false;
+    }
+
+    // Excludes setup work (e.g. rebuilding a graph that the benchmark mutates) from timing.
+    void pause_timing() {
+        if (!running_) {
+            return;
+        }
+        real_ns_ += elapsed_ns(std::chrono::steady_clock::now() - real_start_);
+        cpu_ns_ += cpu_now_ns() - cpu_start_;
+        running_ = false;
+    }
+
+    void resume_timing() {
+        if (running_) {
+            return;
+        }
+        real_start_ = std::chrono::steady_clock::now();
+        cpu_start_ = cpu_now_ns();
+        running_ = true;
+    }
+
+    void set_items_processed(int64_t items) { items_processed_ = items; }
+
+    int64_t iterations() const { return iterations_; }
+    int64_t items_processed() const { return items_processed_; }
+    double real_ns() const { return real_ns_; }
+    double cpu_ns() const { return cpu_ns_; }
+
+   private:
+    static double elapsed_ns(std::chrono::steady_clock::duration d) {
+        return std::chrono::duration<double, std::nano>(d).count();
+    }
+
+    static double cpu_now_ns() {
+        timespec ts{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return static_cast<double>(ts.tv_sec) * 1e9 + static_cast<double>(ts.tv_nsec);
+    }
+
+    int64_t max_iterations_;
+    int64_t iterations_{0};
+    int64_t items_processed_{0};
+
+    bool running_{false};
+    std::chrono::steady_clock::time_point real_start_{};
+    double cpu_start_{0};
+    double real_ns_{0};
+    double cpu_ns_{0};
+};
+
+using BenchmarkFn = std::function<void(State&)>;
+
+struct Benchmark {
+    std::string name;
+    BenchmarkFn fn;
+};
+
+inline std::vector<Benchmark>& registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+inline void register_benchmark(std::string name, BenchmarkFn fn) {
+    registry().push_back({std::move(name), std::move(fn)});
+}
+
+struct Result {
+    std::string name;
+    int64_t iterations;
+    double real_ns_per_iter;
+    double cpu_ns_per_iter;
+    double items_per_second;
+};
+
+struct Options {
+    std::string filter{};
+    std::string json_path{};
+    double min_time_s{0.5};
+    int64_t max_iterations{1'000'000'000};
+};
+
+inline Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        auto value_of = [&](std::string_view flag) -> std::string {
+            return std::string{arg.substr(flag.size())};
+        };
+        if (arg.starts_with("--filter=")) {
+            options.filter = value_of("--filter=");
+        } else if (arg.starts_with("--json=")) {
+            options.json_path = value_of("--json=");
+        } else if (arg.starts_with("--min-time=")) {
+            options.min_time_s = std::stod(value_of("--min-time="));
+        } else if (arg.starts_with("--max-iterations=")) {
+            options.max_iterations = std::stoll(value_of("--max-iterations="));
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--filter=<substring>] [--json=<path>] [--min-time=<seconds>]"
+                         " [--max-iterations=<n>]\n";
+            std::exit(1);
+        }
+    }
+    return options;
+}
+
+// Same calibration scheme as Google Benchmark: grow the iteration count until a run
+// takes at least min_time, then report that run.
+inline Result run_one(const Benchmark& benchmark, const Options& options) {
+    int64_t iterations = 1;
+    while (true) {
+        State state{iterations};
+        benchmark.fn(state);
+
+        const double seconds = state.real_ns() / 1e9;
+        if (seconds >= options.min_time_s || iterations >= options.max_iterations) {
+            const double per_iter = static_cast<double>(state.iterations());
+            return Result{
+                .name = benchmark.name,
+                .iterations = state.iterations(),
+                .real_ns_per_iter = state.real_ns() / per_iter,
+                .cpu_ns_per_iter = state.cpu_ns() / per_iter,
+                .items_per_second =
+                    seconds > 0 ? static_cast<double>(state.items_processed()) / seconds : 0,
+            };
+        }
+
+        const double multiplier =
+            seconds <= 0 ? 10.0 : std::clamp(1.4 * options.min_time_s / seconds, 1.5, 10.0);
+        iterations = std::min(options.max_iterations,
+                              static_cast<int64_t>(static_cast<double>(iterations) * multiplier) + 1);
+    }
+}
+
+inline std::string json_escape(std::string_view s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+inline void write_json(std::ostream& out, const std::vector<Result>& results) {
+    char date[64];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+
+    out << "{\n  \"context\": {\n";
+    out << "    \"date\": \"" << date << "\",\n";
+    out << "    \"host_name\": \"" << json_escape(host) << "\",\n";
+    out << "    \"executable\": \"autodiff_benchmarks\",\n";
+    out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+    out << "    \"library_build_type\": \"release\"\n";
+#else
+    out << "    \"library_build_type\": \"debug\"\n";
+#endif
+    out << "  },\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "    {\n";
+        out << "      \"name\": \"" << json_escape(r.name) << "\",\n";
+        out << "      \"run_name\": \"" << json_escape(r.name) << "\",\n";
+        out << "      \"run_type\": \"iteration\",\n";
+        out << "      \"iterations\": " << r.iterations << ",\n";
+        out << "      \"real_time\": " << r.real_ns_per_iter << ",\n";
+        out << "      \"cpu_time\": " << r.cpu_ns_per_iter << ",\n";
+        out << "      \"time_unit\": \"ns\",\n";
+        out << "      \"items_per_second\": " << r.items_per_second << "\n";
+        out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+inline int run_main(int argc, char** argv) {
+    const Options options = parse_options(argc, argv);
+
+    std::vector<Result> results;
+    for (const Benchmark& benchmark : registry()) {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        Result result = run_one(benchmark, options);
+        std::cout << result.name << "\t" << result.real_ns_per_iter << " ns\t"
+                  << result.cpu_ns_per_iter << " ns cpu\t" << result.iterations << " iters" << std::endl;
+        results.push_back(std::move(result));
+    }
+
+    if (!options.json_path.empty()) {
+        std::ofstream out{options.json_path};
+        if (!out) {
+            std::cerr << "Could not open " << options.json_path << " for writing\n";
+            return 1;
+        }
+        write_json(out, results);
+    }
+    return 0;
+}
+
+}  // namespace bench
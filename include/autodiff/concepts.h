@@ -1,6 +1,21 @@
 #pragma once
 
 #include <concepts>
+#include <type_traits>
 
+// Non-builtin floating point storage types (see half.h) opt into Numeric through this.
 template <typename T>
-concept Numeric = std::is_arithmetic_v<T>;
+struct is_reduced_precision : std::false_type {};
+
+template <typename T>
+concept Numeric = std::is_arithmetic_v<T> || is_reduced_precision<T>::value;
+
+// The type arithmetic on T is carried out in, and that Node<T> accumulates gradients in.
+// Builtin types are their own accumulator.
+template <typename T>
+struct accumulator {
+    using type = T;
+};
+
+template <typename T>
+using accumulator_t = typename accumulator<T>::type;
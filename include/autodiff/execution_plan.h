@@ -0,0 +1,496 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "autodiff/kernels/transcendental.h"
+#include "autodiff/ops.h"
+#include "autodiff/serialization.h"
+
+namespace grad {
+
+/**
+Runs a serialized graph directly from its GraphView (e.g. an mmap'd file) without
+recreating Node<T> objects. Node values and adjoints live in two flat arrays indexed like
+the serialized nodes, so one plan can be re-run for any number of variable bindings
+without touching the graph, unlike Node::apply_variables.
+
+Adjoints are accumulated in accumulator_t<T>, like Node's, so float16/bfloat16 graphs get
+the same gradients from either executor; they are only rounded to T by the getters that
+return T.
+
+The plan holds on to the view, so the bytes behind it must outlive the plan.
+
+    grad::serialization::MappedGraph<float> graph{"model.adg"};
+    grad::ExecutionPlan<float> plan{graph.view()};
+    plan.set_variable(plan.variable_index("x"), 2.f);
+    float y = plan.evaluate();
+    plan.backward();
+    float dy_dx = plan.variable_grad(plan.variable_index("x"));
+*/
+template <Numeric T>
+class ExecutionPlan {
+   public:
+    using Scalar = accumulator_t<T>;
+
+    explicit ExecutionPlan(const serialization::GraphView<T>& view)
+        : view_{view},
+          values_(view.node_count(), T{0}),
+          grads_(view.node_count(), Scalar{0}),
+          variables_(view.variable_count(), T{0}),
+          variable_grads_(view.variable_count(), Scalar{0}) {}
+
+    size_t node_count() const { return view_.node_count(); }
+    size_t variable_count() const { return view_.variable_count(); }
+    std::string_view variable_name(size_t i) const { return view_.variable_name(i); }
+
+    size_t variable_index(std::string_view name) const {
+        for (size_t i = 0; i < view_.variable_count(); ++i) {
+            if (view_.variable_name(i) == name) {
+                return i;
+            }
+        }
+        throw std::runtime_error("Variable " + std::string{name} + " not found in graph");
+    }
+
+    void set_variable(size_t i, T value) { variables_[i] = value; }
+    void set_variables(std::span<const T> values) {
+        if (values.size() != variables_.size()) {
+            throw std::invalid_argument("Expected " + std::to_string(variables_.size()) + " variable values, got " +
+                                        std::to_string(values.size()));
+        }
+        std::copy(values.begin(), values.end(), variables_.begin());
+    }
+
+    /**************************************
+                   Forward
+    ***************************************/
+    T evaluate() {
+        const auto nodes = view_.nodes();
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const serialization::NodeRecord& node = nodes[i];
+            switch (node.op) {
+                case Op::CONSTANT:
+                    values_[i] = view_.constant(node.payload);
+                    break;
+                case Op::VARIABLE:
+                    values_[i] = variables_[node.payload];
+                    break;
+                default:
+                    values_[i] = node.num_inputs == 1
+                                     ? evaluate_unary_op(node.op, values_[node.inputs[0]])
+                                     : evaluate_binary_op(node.op, values_[node.inputs[0]],
+                                                          values_[node.inputs[1]]);
+                    break;
+            }
+        }
+        return values_[view_.root()];
+    }
+
+    /**************************************
+                   Backprop
+    ***************************************/
+    // Must run after evaluate(). Gradients are w.r.t. the root, same as Node::get_gradients,
+    // and scaled by `seed`.
+    void backward(T seed = T{1}) {
+        std::fill(grads_.begin(), grads_.end(), Scalar{0});
+        std::fill(variable_grads_.begin(), variable_grads_.end(), Scalar{0});
+        grads_[view_.root()] = math::widen(seed);
+
+        const auto nodes = view_.nodes();
+        for (size_t i = nodes.size(); i-- > 0;) {
+            const serialization::NodeRecord& node = nodes[i];
+            const Scalar g = grads_[i];
+            if (node.op == Op::VARIABLE) {
+                variable_grads_[node.payload] += g;
+                continue;
+            }
+            if (node.num_inputs == 0) {
+                continue;
+            }
+
+            const uint32_t a = node.inputs[0];
+            const Scalar x = math::widen(values_[a]);
+            const Scalar y = math::widen(values_[i]);
+            switch (node.op) {
+                case Op::NEGATE:
+                    grads_[a] -= g;
+                    break;
+                case Op::SIN:
+                    grads_[a] += math::cos(x) * g;
+                    break;
+                case Op::COS:
+                    grads_[a] -= math::sin(x) * g;
+                    break;
+                case Op::EXP:
+                    grads_[a] += y * g;
+                    break;
+                case Op::TAN:
+                    grads_[a] += (1 + y * y) * g;
+                    break;
+                case Op::TANH:
+                    grads_[a] += (1 - y * y) * g;
+                    break;
+                case Op::LN:
+                    grads_[a] += g / x;
+                    break;
+                default: {
+                    const uint32_t b = node.inputs[1];
+                    const Scalar x2 = math::widen(values_[b]);
+                    switch (node.op) {
+                        case Op::ADD:
+                            grads_[a] += g;
+                            grads_[b] += g;
+                            break;
+                        case Op::SUB:
+                            grads_[a] += g;
+                            grads_[b] -= g;
+                            break;
+                        case Op::MUL:
+                            grads_[a] += x2 * g;
+                            grads_[b] += x * g;
+                            break;
+                        case Op::DIV:
+                            grads_[a] += g / x2;
+                            grads_[b] -= x * g / (x2 * x2);
+                            break;
+                        case Op::POW:
+                            // Same rule as Node::pow.
+                            grads_[a] += x2 * math::pow(x, x2 - 1) * g;
+                            grads_[b] += math::log(x) * y * g;
+                            break;
+                        default:
+                            throw std::runtime_error("Cannot backprop through op " + op_to_string(node.op));
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    /**************************************
+            Getters and setters
+    ***************************************/
+    T value(size_t node) const { return values_[node]; }
+    T grad(size_t node) const { return static_cast<T>(grads_[node]); }
+    T variable_grad(size_t i) const { return static_cast<T>(variable_grads_[i]); }
+    // Unrounded, e.g. for gathering into a train::ParameterBuffer.
+    std::span<const Scalar> variable_grads() const { return variable_grads_; }
+
+   private:
+    serialization::GraphView<T> view_;
+    std::vector<T> values_;
+    std::vector<Scalar> grads_;
+    std::vector<T> variables_;
+    std::vector<Scalar> variable_grads_;
+};
+
+namespace detail {
+
+// Lane loops are kept branch-free with the op switch hoisted out, so they vectorize.
+// Transcendentals over float/double go through the array kernels at the requested accuracy.
+template <Numeric T>
+void unary_forward(Op op, const T* x, T* y, size_t n,
+                   kernels::Accuracy accuracy = kernels::Accuracy::EXACT) {
+    if constexpr (kernels::KernelType<T>) {
+        switch (op) {
+            case Op::SIN:
+                return kernels::sin(x, y, n, accuracy);
+            case Op::COS:
+                return kernels::cos(x, y, n, accuracy);
+            case Op::EXP:
+                return kernels::exp(x, y, n, accuracy);
+            case Op::TANH:
+                return kernels::tanh(x, y, n, accuracy);
+            case Op::LN:
+                return kernels::log(x, y, n, accuracy);
+            default:
+                break;
+        }
+    }
+    switch (op) {
+        case Op::NEGATE:
+            for (size_t l = 0; l < n; ++l) y[l] = -x[l];
+            break;
+        case Op::SIN:
+            for (size_t l = 0; l < n; ++l) y[l] = math::sin(x[l]);
+            break;
+        case Op::COS:
+            for (size_t l = 0; l < n; ++l) y[l] = math::cos(x[l]);
+            break;
+        case Op::EXP:
+            for (size_t l = 0; l < n; ++l) y[l] = math::exp(x[l]);
+            break;
+        case Op::TAN:
+            for (size_t l = 0; l < n; ++l) y[l] = math::tan(x[l]);
+            break;
+        case Op::TANH:
+            for (size_t l = 0; l < n; ++l) y[l] = math::tanh(x[l]);
+            break;
+        case Op::LN:
+            for (size_t l = 0; l < n; ++l) y[l] = math::log(x[l]);
+            break;
+        default:
+            throw std::runtime_error("Unknown unary operation");
+    }
+}
+
+template <Numeric T>
+void binary_forward(Op op, const T* a, const T* b, T* y, size_t n) {
+    switch (op) {
+        case Op::ADD:
+            for (size_t l = 0; l < n; ++l) y[l] = a[l] + b[l];
+            break;
+        case Op::SUB:
+            for (size_t l = 0; l < n; ++l) y[l] = a[l] - b[l];
+            break;
+        case Op::MUL:
+            for (size_t l = 0; l < n; ++l) y[l] = a[l] * b[l];
+            break;
+        case Op::DIV:
+            for (size_t l = 0; l < n; ++l) y[l] = a[l] / b[l];
+            break;
+        case Op::POW:
+            for (size_t l = 0; l < n; ++l) y[l] = math::pow(a[l], b[l]);
+            break;
+        default:
+            throw std::runtime_error("Unknown binary operation");
+    }
+}
+
+// Accumulates d(root)/dx into gx given x, y = op(x) and g = d(root)/dy. Adjoints are in
+// accumulator_t<T>; values are widened as they're read (a no-op for float and double).
+template <Numeric T, typename G = accumulator_t<T>>
+void unary_backward(Op op, const T* x, const T* y, const G* g, G* gx, size_t n,
+                    kernels::Accuracy accuracy = kernels::Accuracy::EXACT) {
+    if constexpr (kernels::KernelType<T> && std::same_as<G, T>) {
+        switch (op) {
+            case Op::SIN:
+                return kernels::sin_backward(x, g, gx, n, accuracy);
+            case Op::COS:
+                return kernels::cos_backward(x, g, gx, n, accuracy);
+            default:
+                break;
+        }
+    }
+    switch (op) {
+        case Op::NEGATE:
+            for (size_t l = 0; l < n; ++l) gx[l] -= g[l];
+            break;
+        case Op::SIN:
+            for (size_t l = 0; l < n; ++l) gx[l] += math::cos(math::widen(x[l])) * g[l];
+            break;
+        case Op::COS:
+            for (size_t l = 0; l < n; ++l) gx[l] -= math::sin(math::widen(x[l])) * g[l];
+            break;
+        case Op::EXP:
+            for (size_t l = 0; l < n; ++l) gx[l] += math::widen(y[l]) * g[l];
+            break;
+        case Op::TAN:
+            for (size_t l = 0; l < n; ++l) {
+                const G yl = math::widen(y[l]);
+                gx[l] += (1 + yl * yl) * g[l];
+            }
+            break;
+        case Op::TANH:
+            for (size_t l = 0; l < n; ++l) {
+                const G yl = math::widen(y[l]);
+                gx[l] += (1 - yl * yl) * g[l];
+            }
+            break;
+        case Op::LN:
+            for (size_t l = 0; l < n; ++l) gx[l] += g[l] / math::widen(x[l]);
+            break;
+        default:
+            throw std::runtime_error("Cannot backprop through op " + op_to_string(op));
+    }
+}
+
+template <Numeric T, typename G = accumulator_t<T>>
+void binary_backward(Op op, const T* a, const T* b, const T* y, const G* g, G* ga, G* gb,
+                     size_t n) {
+    switch (op) {
+        case Op::ADD:
+            for (size_t l = 0; l < n; ++l) ga[l] += g[l];
+            for (size_t l = 0; l < n; ++l) gb[l] += g[l];
+            break;
+        case Op::SUB:
+            for (size_t l = 0; l < n; ++l) ga[l] += g[l];
+            for (size_t l = 0; l < n; ++l) gb[l] -= g[l];
+            break;
+        case Op::MUL:
+            for (size_t l = 0; l < n; ++l) ga[l] += math::widen(b[l]) * g[l];
+            for (size_t l = 0; l < n; ++l) gb[l] += math::widen(a[l]) * g[l];
+            break;
+        case Op::DIV:
+            for (size_t l = 0; l < n; ++l) ga[l] += g[l] / math::widen(b[l]);
+            for (size_t l = 0; l < n; ++l) {
+                const G bl = math::widen(b[l]);
+                gb[l] -= math::widen(a[l]) * g[l] / (bl * bl);
+            }
+            break;
+        case Op::POW:
+            for (size_t l = 0; l < n; ++l) {
+                const G bl = math::widen(b[l]);
+                ga[l] += bl * math::pow(math::widen(a[l]), bl - 1) * g[l];
+            }
+            for (size_t l = 0; l < n; ++l) gb[l] += math::log(math::widen(a[l])) * math::widen(y[l]) * g[l];
+            break;
+        default:
+            throw std::runtime_error("Cannot backprop through op " + op_to_string(op));
+    }
+}
+
+}  // namespace detail
+
+/**
+Batched version of ExecutionPlan: evaluates the graph for up to `max_lanes` independent
+variable bindings at once. Every node owns a contiguous run of `max_lanes` values (and
+adjoints, in accumulator_t<T> as in ExecutionPlan), so each op is one tight loop over lanes
+instead of one switch per row.
+
+With kernels::Accuracy::FAST, exp/log/sin/cos/tanh use the SIMD polynomial kernels from
+kernels/transcendental.h (a few ULP off libm) instead of calling libm per lane.
+
+    grad::BatchExecutionPlan<double> plan{view, 256};
+    std::span<double> x = plan.variable_lanes(plan.variable_index("x"));
+    // ... fill x[0..n) ...
+    plan.evaluate(n);
+    std::span<const double> y = plan.root_values(n);
+*/
+template <Numeric T>
+class BatchExecutionPlan {
+   public:
+    using Scalar = accumulator_t<T>;
+
+    BatchExecutionPlan(const serialization::GraphView<T>& view, size_t max_lanes,
+                       kernels::Accuracy accuracy = kernels::Accuracy::EXACT)
+        : view_{view},
+          max_lanes_{max_lanes},
+          accuracy_{accuracy},
+          values_(view.node_count() * max_lanes, T{0}),
+          grads_(view.node_count() * max_lanes, Scalar{0}),
+          variables_(view.variable_count() * max_lanes, T{0}),
+          variable_grads_(view.variable_count() * max_lanes, Scalar{0}) {}
+
+    size_t max_lanes() const { return max_lanes_; }
+    kernels::Accuracy accuracy() const { return accuracy_; }
+    size_t node_count() const { return view_.node_count(); }
+    size_t variable_count() const { return view_.variable_count(); }
+    std::string_view variable_name(size_t i) const { return view_.variable_name(i); }
+
+    size_t variable_index(std::string_view name) const {
+        for (size_t i = 0; i < view_.variable_count(); ++i) {
+            if (view_.variable_name(i) == name) {
+                return i;
+            }
+        }
+        throw std::runtime_error("Variable " + std::string{name} + " not found in graph");
+    }
+
+    // Input lanes for variable `i`; write the bindings for lanes [0, n) before evaluate(n).
+    std::span<T> variable_lanes(size_t i) { return {variables_.data() + i * max_lanes_, max_lanes_}; }
+
+    /**************************************
+                   Forward
+    ***************************************/
+    void evaluate(size_t lanes) {
+        check_lanes(lanes);
+        const auto nodes = view_.nodes();
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const serialization::NodeRecord& node = nodes[i];
+            T* out = lanes_of(values_, i);
+            switch (node.op) {
+                case Op::CONSTANT:
+                    std::fill_n(out, lanes, view_.constant(node.payload));
+                    break;
+                case Op::VARIABLE:
+                    std::copy_n(variables_.data() + node.payload * max_lanes_, lanes, out);
+                    break;
+                default:
+                    if (node.num_inputs == 1) {
+                        detail::unary_forward(node.op, lanes_of(values_, node.inputs[0]), out, lanes,
+                                              accuracy_);
+                    } else {
+                        detail::binary_forward(node.op, lanes_of(values_, node.inputs[0]),
+                                               lanes_of(values_, node.inputs[1]), out, lanes);
+                    }
+                    break;
+            }
+        }
+    }
+
+    /**************************************
+                   Backprop
+    ***************************************/
+    // Must run after evaluate(lanes) with the same lane count. `seed` scales every gradient.
+    void backward(size_t lanes, T seed = T{1}) {
+        check_lanes(lanes);
+        std::fill(grads_.begin(), grads_.end(), Scalar{0});
+        std::fill(variable_grads_.begin(), variable_grads_.end(), Scalar{0});
+        std::fill_n(lanes_of(grads_, view_.root()), lanes, math::widen(seed));
+
+        const auto nodes = view_.nodes();
+        for (size_t i = nodes.size(); i-- > 0;) {
+            const serialization::NodeRecord& node = nodes[i];
+            const Scalar* g = lanes_of(grads_, i);
+            if (node.op == Op::VARIABLE) {
+                Scalar* gv = variable_grads_.data() + node.payload * max_lanes_;
+                for (size_t l = 0; l < lanes; ++l) gv[l] += g[l];
+                continue;
+            }
+            if (node.num_inputs == 1) {
+                detail::unary_backward(node.op, lanes_of(values_, node.inputs[0]), lanes_of(values_, i),
+                                       g, lanes_of(grads_, node.inputs[0]), lanes, accuracy_);
+            } else if (node.num_inputs == 2) {
+                detail::binary_backward(node.op, lanes_of(values_, node.inputs[0]),
+                                        lanes_of(values_, node.inputs[1]), lanes_of(values_, i), g,
+                                        lanes_of(grads_, node.inputs[0]),
+                                        lanes_of(grads_, node.inputs[1]), lanes);
+            }
+        }
+    }
+
+    /**************************************
+            Getters and setters
+    ***************************************/
+    std::span<const T> values(size_t node, size_t lanes) const { return {lanes_of(values_, node), lanes}; }
+    std::span<const T> root_values(size_t lanes) const { return values(view_.root(), lanes); }
+    // Unrounded; narrow to T where the gradients leave the plan.
+    std::span<const Scalar> variable_grads(size_t i, size_t lanes) const {
+        return {variable_grads_.data() + i * max_lanes_, lanes};
+    }
+
+   private:
+    void check_lanes(size_t lanes) const {
+        if (lanes > max_lanes_) {
+            throw std::runtime_error("Batch of " + std::to_string(lanes) + " lanes exceeds plan capacity " +
+                                     std::to_string(max_lanes_));
+        }
+    }
+
+    template <typename U>
+    U* lanes_of(std::vector<U>& storage, size_t node) {
+        return storage.data() + node * max_lanes_;
+    }
+    template <typename U>
+    const U* lanes_of(const std::vector<U>& storage, size_t node) const {
+        return storage.data() + node * max_lanes_;
+    }
+
+    serialization::GraphView<T> view_;
+    size_t max_lanes_;
+    kernels::Accuracy accuracy_;
+    std::vector<T> values_;
+    std::vector<Scalar> grads_;
+    std::vector<T> variables_;
+    std::vector<Scalar> variable_grads_;
+};
+
+}  // namespace grad
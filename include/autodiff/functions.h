@@ -19,65 +19,101 @@ ExpressionPtr<T> pow(const ExpressionPtr<T>& lhs, const ExpressionPtr<T>& rhs) {
 
 template <Numeric T>
 ExpressionPtr<T> sin(const ExpressionPtr<T>& expr) {
-    const T operation_result = std::sin(expr->value());
+    const T operation_result = math::sin(expr->value());
     ExpressionPtr<T> new_expr = std::make_shared<Node<T>>(operation_result, Op::SIN,
                                                        typename Node<T>::SubexprContainerT{expr});
     Node<T>* weak_ref = new_expr.get();
     new_expr->set_backprop_fn(
         // d/dx sin(x) = cos(x)
-        [expr, weak_ref]() { expr->accumulate_grad(std::cos(expr->value()) * weak_ref->grad()); });
+        [expr, weak_ref]() { expr->accumulate_grad(math::cos(expr->wide_value()) * weak_ref->wide_grad()); });
     return new_expr;
 }
 
 template <Numeric T>
 ExpressionPtr<T> cos(const ExpressionPtr<T>& expr) {
-    const T operation_result = std::cos(expr->value());
+    const T operation_result = math::cos(expr->value());
     ExpressionPtr<T> new_expr = std::make_shared<Node<T>>(operation_result, Op::COS,
                                                        typename Node<T>::SubexprContainerT{expr});
     Node<T>* weak_ref = new_expr.get();
     new_expr->set_backprop_fn(
         // d/dx cos(x) = -sin(x)
-        [expr, weak_ref]() {  expr->accumulate_grad(-std::sin(expr->value()) * weak_ref->grad()); });
+        [expr, weak_ref]() { expr->accumulate_grad(-math::sin(expr->wide_value()) * weak_ref->wide_grad()); });
     return new_expr;
 }
 
 template <Numeric T>
 ExpressionPtr<T> exp(const ExpressionPtr<T>& expr) {
-    const T operation_result = std::exp(expr->value());
+    const T operation_result = math::exp(expr->value());
     ExpressionPtr<T> new_expr = std::make_shared<Node<T>>(operation_result, Op::EXP,
                                                        typename Node<T>::SubexprContainerT{expr});
     Node<T>* weak_ref = new_expr.get();
     new_expr->set_backprop_fn(
-        // d/dx exp(x) = exp(x)
-        [expr, weak_ref]() { expr->accumulate_grad(std::exp(expr->value()) * weak_ref->grad()); });
+        // d/dx exp(x) = exp(x), which is this node's value
+        [expr, weak_ref]() { expr->accumulate_grad(weak_ref->wide_value() * weak_ref->wide_grad()); });
     return new_expr;
 }
 
 template <Numeric T>
 ExpressionPtr<T> tanh(const ExpressionPtr<T>& expr) {
     // Could also make this as a pure expression of exp(x) for fun
-    const T operation_result = std::tanh(expr->value());
+    const T operation_result = math::tanh(expr->value());
     ExpressionPtr<T> new_expr = std::make_shared<Node<T>>(operation_result, Op::TANH,
                                                        typename Node<T>::SubexprContainerT{expr});
     
     Node<T>* weak_ref = new_expr.get();
     new_expr->set_backprop_fn(
-        // d/dx tanh(x) = 1 - tanh^2(x)
-        [expr, weak_ref]() { expr->accumulate_grad((1 - std::pow(std::tanh(expr->value()), 2)) * weak_ref->grad()); });
+        // d/dx tanh(x) = 1 - tanh^2(x), reusing this node's value
+        [expr, weak_ref]() {
+            const accumulator_t<T> y = weak_ref->wide_value();
+            expr->accumulate_grad((1 - y * y) * weak_ref->wide_grad());
+        });
     return new_expr;
 }
 
 template <Numeric T>
 ExpressionPtr<T> ln(const ExpressionPtr<T>& expr) {
-    const T operation_result = std::log(expr->value());
+    const T operation_result = math::log(expr->value());
     ExpressionPtr<T> new_expr = std::make_shared<Node<T>>(operation_result, Op::LN,
                                                        typename Node<T>::SubexprContainerT{expr});
     
     Node<T>* weak_ref = new_expr.get();
     new_expr->set_backprop_fn(
         // d/dx ln(x) = 1 / x
-        [expr, weak_ref]() { expr->accumulate_grad(std::pow(expr->value(), -1) * weak_ref->grad()); });
+        [expr, weak_ref]() { expr->accumulate_grad(weak_ref->wide_grad() / expr->wide_value()); });
     return new_expr;
 }
 
+/**
+Builds the node for `op` over `inputs` through the same builders as the public API, so the
+result carries the usual backprop closure. Used when recreating graphs from other
+representations (e.g. deserialization).
+*/
+template <Numeric T>
+ExpressionPtr<T> apply_op(Op op, const typename Node<T>::SubexprContainerT& inputs) {
+    switch (op) {
+        case Op::ADD:
+            return inputs[0] + inputs[1];
+        case Op::MUL:
+            return inputs[0] * inputs[1];
+        case Op::POW:
+            return inputs[0]->pow(inputs[1]);
+        case Op::SIN:
+            return sin(inputs[0]);
+        case Op::COS:
+            return cos(inputs[0]);
+        case Op::EXP:
+            return exp(inputs[0]);
+        case Op::TANH:
+            return tanh(inputs[0]);
+        case Op::LN:
+            return ln(inputs[0]);
+        default:
+            // The graph API spells SUB and DIV with ADD, MUL and POW, and has no TAN builder.
+            // Node::operator-() does produce NEGATE, but as a node with no inputs that holds
+            // the negated value; serialize() and IR::lower() store it as a constant, so it
+            // never reaches here with inputs to rebuild from.
+            throw std::runtime_error("No builder for op " + op_to_string(op));
+    }
+}
+
 }  // namespace grad
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "autodiff/graph_helpers.h"
+#include "autodiff/node.h"
+#include "autodiff/profiling.h"
+
+namespace grad {
+
+namespace detail {
+
+inline std::string dot_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+inline std::string format_number(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.4g", value);
+    return buffer;
+}
+
+}  // namespace detail
+
+/**
+Exports the graph rooted at `root` in GraphViz DOT format. Edges point from an input to the
+node consuming it. Shared subexpressions are emitted once, so the output has one DOT node
+per distinct Node<T>.
+
+If `profile` is given (see profiling.h), every node it has stats for is annotated with its
+call counts, forward/backward time and the largest |value|/|grad| seen, and filled with a
+white-to-red heat color proportional to its share of the hottest node's total time.
+
+Render with e.g. `dot -Tsvg graph.dot -o graph.svg`.
+*/
+template <Numeric T>
+std::string to_dot(const ExpressionPtr<T>& root, const profiling::Profile* profile = nullptr) {
+    std::vector<ExpressionPtr<T>> nodes;
+    std::unordered_map<const Node<T>*, size_t> ids;
+
+    graph::traverse<graph::TraversalType::DFS, ExpressionPtr<T>>(
+        root, [](const ExpressionPtr<T>& node) { return node->get_inputs(); },
+        [&](const ExpressionPtr<T>& node) {
+            ids.emplace(node.get(), nodes.size());
+            nodes.push_back(node);
+        });
+
+    uint64_t hottest_ns = 0;
+    if (profile != nullptr) {
+        for (const auto& node : nodes) {
+            if (auto it = profile->find(node.get()); it != profile->end()) {
+                hottest_ns = std::max(hottest_ns, it->second.total_ns());
+            }
+        }
+    }
+
+    std::string dot = "digraph autodiff {\n";
+    dot += "    rankdir=BT;\n";
+    dot += "    node [shape=box, style=filled, fillcolor=white, fontname=\"monospace\"];\n";
+
+    for (const auto& node : nodes) {
+        std::string label;
+        if (node->get_op() == Op::VARIABLE) {
+            label = "Var(" + detail::dot_escape(node->get_var_name()) + ")";
+        } else if (node->get_op() == Op::CONSTANT) {
+            label = "Const(" + detail::format_number(static_cast<double>(node->value())) + ")";
+        } else {
+            label = op_to_string(node->get_op()) +
+                    "\\nvalue=" + detail::format_number(static_cast<double>(node->value()));
+        }
+
+        std::string attributes;
+        if (profile != nullptr) {
+            if (auto it = profile->find(node.get()); it != profile->end()) {
+                const profiling::NodeStats& stats = it->second;
+                label += "\\ncalls fwd=" + std::to_string(stats.forward_calls) +
+                         " bwd=" + std::to_string(stats.backward_calls);
+                label += "\\nns fwd=" + std::to_string(stats.forward_ns) +
+                         " bwd=" + std::to_string(stats.backward_ns);
+                label += "\\n|value|<=" + detail::format_number(stats.max_abs_value) +
+                         " |grad|<=" + detail::format_number(stats.max_abs_grad);
+
+                // HSV: hue 0 (red), saturation scaled by heat, full brightness.
+                const double heat = hottest_ns == 0 ? 0.0
+                                                    : static_cast<double>(stats.total_ns()) /
+                                                          static_cast<double>(hottest_ns);
+                attributes = ", fillcolor=\"0.000 " + detail::format_number(heat) + " 1.000\"";
+            }
+        }
+
+        dot += "    n" + std::to_string(ids.at(node.get())) + " [label=\"" + label + "\"" +
+               attributes + "];\n";
+    }
+
+    for (const auto& node : nodes) {
+        const size_t consumer = ids.at(node.get());
+        for (const auto& input : node->get_inputs()) {
+            dot += "    n" + std::to_string(ids.at(input.get())) + " -> n" +
+                   std::to_string(consumer) + ";\n";
+        }
+    }
+
+    dot += "}\n";
+    return dot;
+}
+
+}  // namespace grad
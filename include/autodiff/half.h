@@ -0,0 +1,210 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "autodiff/concepts.h"
+
+/**
+Software 16-bit floating point storage types, for graphs that are bound by memory
+bandwidth rather than arithmetic. Only storage is 16 bits: every operation widens its
+operands to the accumulator type (float, or AUTODIFF_REDUCED_PRECISION_ACCUMULATOR),
+computes there and rounds the result back to nearest-even, and Node<T> accumulates
+gradients in the accumulator type (see concepts.h).
+
+    grad::float16  - IEEE 754 binary16: 1 sign, 5 exponent, 10 mantissa bits
+    grad::bfloat16 - bfloat16: the top half of a float (8 exponent, 7 mantissa bits)
+
+These stand in for C++23 std::float16_t/std::bfloat16_t, which this toolchain doesn't have.
+Conversion to the accumulator type is explicit so that mixed expressions like `2 * x` stay in
+the 16-bit type instead of silently becoming float.
+*/
+#ifndef AUTODIFF_REDUCED_PRECISION_ACCUMULATOR
+#define AUTODIFF_REDUCED_PRECISION_ACCUMULATOR float
+#endif
+
+namespace grad {
+
+namespace detail {
+
+inline uint16_t float_to_half_bits(float value) {
+    const uint32_t bits = std::bit_cast<uint32_t>(value);
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7fffffff;
+
+    if (magnitude >= 0x7f800000) {
+        // inf stays inf; NaN keeps its top payload bits and stays quiet.
+        return sign | (magnitude > 0x7f800000 ? 0x7e00 | ((magnitude >> 13) & 0x3ff) : 0x7c00);
+    }
+    if (magnitude >= 0x477ff000) {
+        // >= 65520 rounds past the largest half (65504).
+        return sign | 0x7c00;
+    }
+    if (magnitude < 0x38800000) {
+        // Below the smallest normal half (2^-14): round to a subnormal by letting the float
+        // adder shift the mantissa out, since 0.5f has the exponent of 2^-14 * 2^13.
+        const float shifted = std::bit_cast<float>(magnitude) + 0.5f;
+        return sign | static_cast<uint16_t>(std::bit_cast<uint32_t>(shifted) - 0x3f000000);
+    }
+    // Normal: rebias the exponent (127 -> 15) and round the 13 dropped bits to nearest even.
+    const uint32_t odd = (magnitude >> 13) & 1;
+    const uint32_t rounded = magnitude + 0xfff + odd - 0x38000000;
+    return sign | static_cast<uint16_t>(rounded >> 13);
+}
+
+inline float half_bits_to_float(uint16_t half) {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    const uint32_t mantissa = half & 0x3ff;
+
+    if (exponent == 0x1f) {
+        return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+    }
+    if (exponent == 0) {
+        // Zero or subnormal: mantissa * 2^-24, exact in float.
+        const float value = static_cast<float>(mantissa) * 5.9604644775390625e-8f;
+        return sign != 0 ? -value : value;
+    }
+    return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+inline uint16_t float_to_bfloat16_bits(float value) {
+    const uint32_t bits = std::bit_cast<uint32_t>(value);
+    if ((bits & 0x7fffffff) > 0x7f800000) {
+        return static_cast<uint16_t>((bits >> 16) | 0x0040);  // keep NaNs quiet
+    }
+    const uint32_t odd = (bits >> 16) & 1;
+    return static_cast<uint16_t>((bits + 0x7fff + odd) >> 16);
+}
+
+inline float bfloat16_bits_to_float(uint16_t bits) {
+    return std::bit_cast<float>(static_cast<uint32_t>(bits) << 16);
+}
+
+// Shared operators for the 16-bit types. `Derived` converts explicitly to the accumulator
+// type and back through its constructors; negation just flips the sign bit.
+template <typename Derived>
+struct ReducedPrecisionOps {
+    using Accumulator = AUTODIFF_REDUCED_PRECISION_ACCUMULATOR;
+
+    friend Derived operator+(Derived a, Derived b) { return Derived{a.widen() + b.widen()}; }
+    friend Derived operator-(Derived a, Derived b) { return Derived{a.widen() - b.widen()}; }
+    friend Derived operator*(Derived a, Derived b) { return Derived{a.widen() * b.widen()}; }
+    friend Derived operator/(Derived a, Derived b) { return Derived{a.widen() / b.widen()}; }
+    friend Derived operator-(Derived a) { return Derived::from_bits(a.bits ^ 0x8000); }
+
+    friend Derived& operator+=(Derived& a, Derived b) { return a = a + b; }
+    friend Derived& operator-=(Derived& a, Derived b) { return a = a - b; }
+    friend Derived& operator*=(Derived& a, Derived b) { return a = a * b; }
+    friend Derived& operator/=(Derived& a, Derived b) { return a = a / b; }
+
+    friend bool operator==(Derived a, Derived b) { return a.widen() == b.widen(); }
+    friend bool operator<(Derived a, Derived b) { return a.widen() < b.widen(); }
+    friend bool operator>(Derived a, Derived b) { return a.widen() > b.widen(); }
+    friend bool operator<=(Derived a, Derived b) { return a.widen() <= b.widen(); }
+    friend bool operator>=(Derived a, Derived b) { return a.widen() >= b.widen(); }
+
+    uint16_t bits{0};
+
+   private:
+    Accumulator widen() const { return static_cast<Accumulator>(static_cast<const Derived&>(*this)); }
+};
+
+}  // namespace detail
+
+struct float16 : detail::ReducedPrecisionOps<float16> {
+    float16() = default;
+    float16(float value) { bits = detail::float_to_half_bits(value); }
+    float16(double value) : float16(static_cast<float>(value)) {}
+    float16(int value) : float16(static_cast<float>(value)) {}
+
+    explicit operator float() const { return detail::half_bits_to_float(bits); }
+    explicit operator double() const { return static_cast<double>(static_cast<float>(*this)); }
+
+    static float16 from_bits(uint16_t raw) {
+        float16 h;
+        h.bits = raw;
+        return h;
+    }
+};
+
+struct bfloat16 : detail::ReducedPrecisionOps<bfloat16> {
+    bfloat16() = default;
+    bfloat16(float value) { bits = detail::float_to_bfloat16_bits(value); }
+    bfloat16(double value) : bfloat16(static_cast<float>(value)) {}
+    bfloat16(int value) : bfloat16(static_cast<float>(value)) {}
+
+    explicit operator float() const { return detail::bfloat16_bits_to_float(bits); }
+    explicit operator double() const { return static_cast<double>(static_cast<float>(*this)); }
+
+    static bfloat16 from_bits(uint16_t raw) {
+        bfloat16 b;
+        b.bits = raw;
+        return b;
+    }
+};
+
+static_assert(sizeof(float16) == 2 && sizeof(bfloat16) == 2);
+
+}  // namespace grad
+
+/**************************************
+        Numeric / accumulator traits
+***************************************/
+template <>
+struct is_reduced_precision<grad::float16> : std::true_type {};
+template <>
+struct is_reduced_precision<grad::bfloat16> : std::true_type {};
+
+template <>
+struct accumulator<grad::float16> {
+    using type = AUTODIFF_REDUCED_PRECISION_ACCUMULATOR;
+};
+template <>
+struct accumulator<grad::bfloat16> {
+    using type = AUTODIFF_REDUCED_PRECISION_ACCUMULATOR;
+};
+
+template <>
+struct std::numeric_limits<grad::float16> {
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = false;
+    static constexpr bool is_exact = false;
+    static constexpr bool has_infinity = true;
+    static constexpr bool has_quiet_NaN = true;
+    static constexpr int digits = 11;
+    static constexpr int max_exponent = 16;
+    static constexpr int min_exponent = -13;
+
+    static grad::float16 min() { return grad::float16::from_bits(0x0400); }
+    static grad::float16 max() { return grad::float16::from_bits(0x7bff); }
+    static grad::float16 lowest() { return grad::float16::from_bits(0xfbff); }
+    static grad::float16 epsilon() { return grad::float16::from_bits(0x1400); }
+    static grad::float16 denorm_min() { return grad::float16::from_bits(0x0001); }
+    static grad::float16 infinity() { return grad::float16::from_bits(0x7c00); }
+    static grad::float16 quiet_NaN() { return grad::float16::from_bits(0x7e00); }
+};
+
+template <>
+struct std::numeric_limits<grad::bfloat16> {
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = false;
+    static constexpr bool is_exact = false;
+    static constexpr bool has_infinity = true;
+    static constexpr bool has_quiet_NaN = true;
+    static constexpr int digits = 8;
+    static constexpr int max_exponent = 128;
+    static constexpr int min_exponent = -125;
+
+    static grad::bfloat16 min() { return grad::bfloat16::from_bits(0x0080); }
+    static grad::bfloat16 max() { return grad::bfloat16::from_bits(0x7f7f); }
+    static grad::bfloat16 lowest() { return grad::bfloat16::from_bits(0xff7f); }
+    static grad::bfloat16 epsilon() { return grad::bfloat16::from_bits(0x3c00); }
+    static grad::bfloat16 denorm_min() { return grad::bfloat16::from_bits(0x0001); }
+    static grad::bfloat16 infinity() { return grad::bfloat16::from_bits(0x7f80); }
+    static grad::bfloat16 quiet_NaN() { return grad::bfloat16::from_bits(0x7fc0); }
+};
@@ -1,16 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <functional>
 #include <memory>
 #include <queue>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 #include <cmath>
 #include <string>
 
 #include "autodiff/concepts.h"
 #include "autodiff/ops.h"
-#include "autodiff/graph_helpers.h"
+#include "autodiff/profiling.h"
 
 namespace grad {
 
@@ -37,21 +39,25 @@ class Node : public std::enable_shared_from_this<Node<T>> {
     /**************************************
                    Backprop
     ***************************************/
-    void get_gradients() {
+    // `seed` is d(output)/d(this); anything other than 1 scales every gradient, e.g. for
+    // loss scaling with reduced precision types (see train/loss_scaler.h).
+    void get_gradients(T seed = T{1}) {
         std::vector<ExpressionPtr> sorted_nodes = input_topological_ordering();
 
         for (auto& node : sorted_nodes) {
             node->set_grad(0);
         }
 
-        set_grad(1);
+        set_grad(seed);
 
         for (auto& subexpr : sorted_nodes) {
             if (subexpr->op_ == Op::VARIABLE) {
                 throw std::runtime_error("Cannot backprop on variable "+ subexpr->var_name_ + " without applying a value to it.");
                 continue;
             }
+            const auto start = profiling::now();
             subexpr->backprop_fn_();
+            profiling::record_backward(subexpr.get(), start, subexpr->grad_);
         }
     }
 
@@ -83,10 +89,17 @@ class Node : public std::enable_shared_from_this<Node<T>> {
     ***************************************/
     T value() const { return value_; }
     void set_value(T value) { value_ = value; }
-
-    T grad() const { return grad_; }
-    void accumulate_grad(T grad) { grad_ += grad; }
-    void set_grad(T grad) { grad_ = grad; }
+    // The value in accumulator_t<T>, which backprop closures do their arithmetic in.
+    accumulator_t<T> wide_value() const { return math::widen(value_); }
+
+    T grad() const { return static_cast<T>(grad_); }
+    // The adjoint as accumulated, before grad() rounds it to T (they only differ for reduced
+    // precision types).
+    accumulator_t<T> wide_grad() const { return grad_; }
+    // Backprop passes gradients in accumulator_t<T>, so reduced precision graphs only round
+    // when grad() is read, not at every hop.
+    void accumulate_grad(accumulator_t<T> grad) { grad_ += grad; }
+    void set_grad(T grad) { grad_ = math::widen(grad); }
     void zero_grad() { grad_ = 0; }
 
     const SubexprContainerT& get_inputs() const { return inputs_; }
@@ -95,6 +108,7 @@ class Node : public std::enable_shared_from_this<Node<T>> {
 
     void mark_as_const() { op_ = Op::CONSTANT; }
     Op get_op() const { return op_; }
+    const std::string& get_var_name() const { return var_name_; }
 
     void clear_inputs() { inputs_.clear(); }
 
@@ -117,8 +131,8 @@ class Node : public std::enable_shared_from_this<Node<T>> {
 
         Node<T>* weak_ref = new_expr.get();
         new_expr->backprop_fn_ = [this, other, weak_ref]() {
-            this->accumulate_grad(1 * weak_ref->grad());
-            other->accumulate_grad(1 * weak_ref->grad());
+            this->accumulate_grad(weak_ref->wide_grad());
+            other->accumulate_grad(weak_ref->wide_grad());
         };
         return new_expr;
     }
@@ -135,8 +149,8 @@ class Node : public std::enable_shared_from_this<Node<T>> {
 
         Node<T>* weak_ref = new_expr.get();
         new_expr->backprop_fn_ = [this, other, weak_ref]() {
-            this->accumulate_grad(other->value() * weak_ref->grad());
-            other->accumulate_grad(this->value() * weak_ref->grad());
+            this->accumulate_grad(other->wide_value() * weak_ref->wide_grad());
+            other->accumulate_grad(this->wide_value() * weak_ref->wide_grad());
         };
         return new_expr;
     }
@@ -148,7 +162,7 @@ class Node : public std::enable_shared_from_this<Node<T>> {
     }
 
     ExpressionPtr pow(const ExpressionPtr& other) {
-        const T operation_result = std::pow(value(), other->value());
+        const T operation_result = math::pow(value(), other->value());
 
         ExpressionPtr new_expr = std::make_shared<Node<T>>(
             operation_result, Op::POW, SubexprContainerT{this->shared_from_this(), other});
@@ -158,10 +172,12 @@ class Node : public std::enable_shared_from_this<Node<T>> {
         // da/dx = b * x ^ (b - 1)
         // a = b^x
         // da/dx = log(b) * b^x
+        // (b^x is this node's value.)
         new_expr->backprop_fn_ = [this, other, weak_ref]() {
-            this->accumulate_grad(other->value() * std::pow(this->value(), other->value() - 1) *
-                                  weak_ref->grad());
-            other->accumulate_grad(std::log(this->value()) * std::pow(this->value(), other->value()) * weak_ref->grad());
+            const accumulator_t<T> base = this->wide_value();
+            const accumulator_t<T> exponent = other->wide_value();
+            this->accumulate_grad(exponent * math::pow(base, exponent - 1) * weak_ref->wide_grad());
+            other->accumulate_grad(math::log(base) * weak_ref->wide_value() * weak_ref->wide_grad());
         };
         return new_expr;
     }
@@ -238,7 +254,7 @@ class Node : public std::enable_shared_from_this<Node<T>> {
         if (op_ == Op::VARIABLE) {
             repr += "Var(" + var_name_ + ")";
         } else if (op_ == Op::CONSTANT) {
-            repr += "Const(" + std::to_string(value_) + ")";
+            repr += "Const(" + std::to_string(math::widen(value_)) + ")";
         } else if (is_unary_op(op_)) {
             repr += op_to_string(op_) + "(" + inputs_[0]->to_string() + ")";
         } else if (is_binary_op(op_)) {
@@ -254,33 +270,53 @@ class Node : public std::enable_shared_from_this<Node<T>> {
         return []() {};
     }
 
+    // Every node reachable from this one, each before all of its inputs, so a node's backprop
+    // only runs once all of its consumers have added to its gradient. (A BFS order isn't
+    // enough on a DAG: a node shared by a short and a long path is reached through the short
+    // one before the long one has finished accumulating into it.) Reverse of an iterative
+    // post-order, so deep chains don't overflow the stack.
     std::vector<ExpressionPtr> input_topological_ordering() {
         std::vector<ExpressionPtr> sorted;
-
-        graph::traverse<graph::TraversalType::BFS, ExpressionPtr>(
-            this->shared_from_this(),
-            [](const ExpressionPtr& node) {
-                return node->get_inputs();
-            },
-            [&sorted](const ExpressionPtr& node) {
-                sorted.push_back(node);
+        std::unordered_set<const Node*> visited{this};
+        std::vector<std::pair<ExpressionPtr, size_t>> stack;
+        stack.emplace_back(this->shared_from_this(), 0);
+
+        while (!stack.empty()) {
+            auto& [node, next_input] = stack.back();
+            if (next_input < node->inputs_.size()) {
+                const ExpressionPtr& input = node->inputs_[next_input++];
+                if (visited.insert(input.get()).second) {
+                    stack.emplace_back(input, 0);
+                }
+                continue;
             }
-        );
-
+            sorted.push_back(std::move(node));
+            stack.pop_back();
+        }
+        std::reverse(sorted.begin(), sorted.end());
         return sorted;
     }
 
     T evaluate_helper(const ExpressionPtr& expr) {
         if (expr->op_ == Op::CONSTANT) {
+            profiling::record_forward(expr.get(), profiling::now(), expr->value_);
             return expr->value_;
         }
 
         T result{0};
 
+        // Inputs are evaluated before starting the clock so profiles only count this node's op.
         if (is_unary_op(expr->op_)) {
-            result = evaluate_unary_op(expr->op_, evaluate_helper(expr->inputs_[0]));
+            const T input = evaluate_helper(expr->inputs_[0]);
+            const auto start = profiling::now();
+            result = evaluate_unary_op(expr->op_, input);
+            profiling::record_forward(expr.get(), start, result);
         } else if (is_binary_op(expr->op_)) {
-            result = evaluate_binary_op(expr->op_, evaluate_helper(expr->inputs_[0]), evaluate_helper(expr->inputs_[1]));
+            const T lhs = evaluate_helper(expr->inputs_[0]);
+            const T rhs = evaluate_helper(expr->inputs_[1]);
+            const auto start = profiling::now();
+            result = evaluate_binary_op(expr->op_, lhs, rhs);
+            profiling::record_forward(expr.get(), start, result);
         } else {
             // Wish I had reflection here...
             throw std::runtime_error("Cannot evaluate node with op type " + std::to_string(static_cast<int>(expr->op_)));
@@ -294,7 +330,8 @@ class Node : public std::enable_shared_from_this<Node<T>> {
     Op op_{Op::UNKNOWN};
     std::string var_name_{};
 
-    T grad_{0};
+    // Accumulated in the wider type so reduced precision T doesn't lose small contributions.
+    accumulator_t<T> grad_{0};
     SubexprContainerT inputs_{};
     BackpropFnType backprop_fn_{};
 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cmath>
+#include <stdexcept>
 #include <string>
 
 #include "autodiff/concepts.h"
@@ -53,23 +55,52 @@ inline bool is_binary_op(Op op) {
     }
 }
 
+/**************************************
+       Math in the accumulator type
+***************************************/
+// std:: math for every Numeric T: computed in accumulator_t<T> and rounded back to T. For
+// builtin types these are plain forwarding calls.
+namespace math {
+
+template <Numeric T>
+inline accumulator_t<T> widen(T value) {
+    return static_cast<accumulator_t<T>>(value);
+}
+
+template <Numeric T>
+inline T sin(T x) { return static_cast<T>(std::sin(widen(x))); }
+template <Numeric T>
+inline T cos(T x) { return static_cast<T>(std::cos(widen(x))); }
+template <Numeric T>
+inline T exp(T x) { return static_cast<T>(std::exp(widen(x))); }
+template <Numeric T>
+inline T tan(T x) { return static_cast<T>(std::tan(widen(x))); }
+template <Numeric T>
+inline T tanh(T x) { return static_cast<T>(std::tanh(widen(x))); }
+template <Numeric T>
+inline T log(T x) { return static_cast<T>(std::log(widen(x))); }
+template <Numeric T>
+inline T pow(T x, T y) { return static_cast<T>(std::pow(widen(x), widen(y))); }
+
+}  // namespace math
+
 template <Numeric T>
 inline T evaluate_unary_op(Op op, T input) {
     switch (op) {
         case Op::NEGATE:
             return -input;
         case Op::SIN:
-            return std::sin(input);
+            return math::sin(input);
         case Op::COS:
-            return std::cos(input);
+            return math::cos(input);
         case Op::EXP:
-            return std::exp(input);
+            return math::exp(input);
         case Op::TAN:
-            return std::tan(input);
+            return math::tan(input);
         case Op::TANH:
-            return std::tanh(input);
+            return math::tanh(input);
         case Op::LN:
-            return std::log(input);
+            return math::log(input);
         default:
             throw std::runtime_error("Unknown unary operation");
     }
@@ -87,7 +118,7 @@ inline T evaluate_binary_op(Op op, T input1, T input2) {
         case Op::DIV:
             return input1 / input2;
         case Op::POW:
-            return std::pow(input1, input2);
+            return math::pow(input1, input2);
         default:
             throw std::runtime_error("Unknown binary operation");
     }
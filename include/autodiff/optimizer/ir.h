@@ -0,0 +1,478 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "autodiff/functions.h"
+#include "autodiff/node.h"
+#include "autodiff/ops.h"
+
+namespace grad::optimizer {
+
+using ValueId = uint32_t;
+inline constexpr ValueId kNoValue = UINT32_MAX;
+
+namespace detail {
+
+// Node address -> ValueId while lowering. Open addressing with linear probing, since on graphs
+// of millions of nodes every lookup is a cache miss and std::unordered_map adds another one
+// per entry.
+class NodeIdMap {
+public:
+    // The slot index for `key`, and whether it was just inserted (holding kNoValue). Slot
+    // indices stay valid until the table grows, which bumps generation().
+    std::pair<size_t, bool> try_emplace(const void* key) {
+        if ((size_ + 1) * 2 > entries_.size()) {
+            grow();
+        }
+        size_t i = slot_of(key);
+        while (entries_[i].key != nullptr) {
+            if (entries_[i].key == key) {
+                return {i, false};
+            }
+            i = (i + 1) & (entries_.size() - 1);
+        }
+        entries_[i] = {key, kNoValue};
+        ++size_;
+        return {i, true};
+    }
+
+    ValueId& value(size_t slot) { return entries_[slot].value; }
+
+    // `key` must have been inserted.
+    ValueId& at(const void* key) {
+        size_t i = slot_of(key);
+        while (entries_[i].key != key) {
+            i = (i + 1) & (entries_.size() - 1);
+        }
+        return entries_[i].value;
+    }
+
+    uint32_t generation() const { return generation_; }
+
+private:
+    // Key and value side by side, so a lookup is one cache miss.
+    struct Entry {
+        const void* key;
+        ValueId value;
+    };
+
+    size_t slot_of(const void* key) const {
+        return static_cast<size_t>((reinterpret_cast<uintptr_t>(key) * 0x9e3779b97f4a7c15ULL) >> shift_);
+    }
+
+    void grow() {
+        std::vector<Entry> old = std::move(entries_);
+        const size_t capacity = old.empty() ? 1024 : old.size() * 2;
+        entries_.assign(capacity, Entry{nullptr, kNoValue});
+        shift_ = 64 - std::countr_zero(capacity);
+        ++generation_;
+        for (const Entry& entry : old) {
+            if (entry.key != nullptr) {
+                size_t j = slot_of(entry.key);
+                while (entries_[j].key != nullptr) {
+                    j = (j + 1) & (capacity - 1);
+                }
+                entries_[j] = entry;
+            }
+        }
+    }
+
+    std::vector<Entry> entries_;
+    size_t size_{0};
+    int shift_{64};
+    uint32_t generation_{0};
+};
+
+} // detail
+
+/**
+Flat SSA form of an expression graph for the optimizer passes. Every node becomes one value
+with an integer id; ids are a topological order (operands always have smaller ids than their
+users), so a forward sweep over ids visits producers first and a backward sweep consumers
+first.
+
+Per-value data lives in parallel arrays indexed by id. Operand and user lists are CSR-packed
+(an offsets array plus one flat array of ids), and use_count(v) is the number of operand
+slots that currently refer to v. Rewrites are O(1) per edge:
+
+    - replace_all_uses(old, new) patches each user of `old` and splices `old`'s user list
+      onto `new`'s instead of copying it.
+    - fold_to_constant(v, value) turns v into a leaf and drops its operand edges.
+    - erase(v) deletes a value nobody uses.
+
+Erased values keep their id (as Op::UNKNOWN) until compact() renumbers the live ones.
+
+Leaves remember the Node they were lowered from, and raise() hands back those same nodes
+wherever the leaf survives the passes. A leaf constant is just a constant to the passes,
+though: ConstantFoldingPass will fold it into its users, and trainable parameters (see
+train::ParameterBuffer) would then no longer reach the optimized graph. pin() marks such
+leaves as opaque to folding, so they stay the same objects in the optimized graph.
+The IR doesn't own the leaves: the lowered graph has to stay alive until the IR is raised.
+*/
+template<Numeric T>
+class IR {
+public:
+    /**************************************
+              Lowering and raising
+    ***************************************/
+    // Iterative post-order, so deep chains don't overflow the stack. Variables with the same
+    // name share one value, matching how apply_variables binds them.
+    static IR lower(const ExpressionPtr<T>& root) {
+        IR ir;
+        detail::NodeIdMap ids;
+        std::unordered_map<std::string, ValueId> variables;
+        // Ids travel up the stack into the parent's frame, so each edge costs one map lookup
+        // (when it's discovered) rather than one per edge plus one per node.
+        struct Frame {
+            const ExpressionPtr<T>* expr;
+            size_t slot;
+            uint32_t generation;
+            uint32_t next_input;
+            ValueId operands[2];
+        };
+        constexpr size_t kNoSlot = SIZE_MAX;
+        std::vector<Frame> stack;
+        stack.push_back({&root, ids.try_emplace(root.get()).first, ids.generation(), 0, {}});
+        ValueId root_id = kNoValue;
+
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            const ExpressionPtr<T>& expr = *frame.expr;
+            Node<T>* node = expr.get();
+            if (!is_leaf_node(*node) && frame.next_input < node->get_inputs().size()) {
+                const uint32_t i = frame.next_input++;
+                const ExpressionPtr<T>& input = node->get_inputs()[i];
+                // An input owned only by this edge can't be reached any other way, so it needs
+                // no entry in `ids`.
+                if (input.use_count() == 1) {
+                    stack.push_back({&input, kNoSlot, 0, 0, {}});
+                    continue;
+                }
+                const auto [slot, inserted] = ids.try_emplace(input.get());
+                if (inserted) {
+                    stack.push_back({&input, slot, ids.generation(), 0, {}});
+                } else {
+                    frame.operands[i] = ids.value(slot);
+                }
+                continue;
+            }
+
+            ValueId id;
+            if (node->get_op() == Op::VARIABLE) {
+                auto [it, inserted] = variables.emplace(node->get_var_name(), ValueId{0});
+                if (inserted) {
+                    it->second = ir.add_variable(node);
+                }
+                id = it->second;
+            } else if (is_leaf_node(*node)) {
+                id = ir.add_constant(node->value(), node);
+            } else {
+                id = ir.add_op(node->get_op(), std::span{frame.operands, node->get_inputs().size()});
+            }
+            if (frame.slot != kNoSlot) {
+                (frame.generation == ids.generation() ? ids.value(frame.slot) : ids.at(node)) = id;
+            }
+            stack.pop_back();
+            if (stack.empty()) {
+                root_id = id;
+            } else {
+                stack.back().operands[stack.back().next_input - 1] = id;
+            }
+        }
+        ir.root_ = root_id;
+        ir.build_users();
+        return ir;
+    }
+
+    // Rebuilds Node objects for every value the root depends on.
+    ExpressionPtr<T> raise() const {
+        const std::vector<bool> needed = reachable_from_root();
+        std::vector<ExpressionPtr<T>> built(size());
+        for (ValueId v = 0; v < size(); ++v) {
+            if (!needed[v]) {
+                continue;
+            }
+            if (ops_[v] == Op::CONSTANT) {
+                Node<T>* original = constant_nodes_[payloads_[v]];
+                built[v] = original ? original->shared_from_this() : constant(constants_[payloads_[v]]);
+            } else if (ops_[v] == Op::VARIABLE) {
+                built[v] = variable_nodes_[payloads_[v]]->shared_from_this();
+            } else {
+                typename Node<T>::SubexprContainerT inputs;
+                for (ValueId operand : operands(v)) {
+                    inputs.push_back(built[operand]);
+                }
+                built[v] = apply_op<T>(ops_[v], inputs);
+            }
+        }
+        return built[root_];
+    }
+
+    /**************************************
+                   Queries
+    ***************************************/
+    // Number of ids, including erased values.
+    size_t size() const { return ops_.size(); }
+    size_t live_count() const { return live_count_; }
+    ValueId root() const { return root_; }
+
+    Op op(ValueId v) const { return ops_[v]; }
+    bool is_leaf(ValueId v) const { return ops_[v] == Op::CONSTANT || ops_[v] == Op::VARIABLE; }
+    bool is_erased(ValueId v) const { return ops_[v] == Op::UNKNOWN; }
+
+    std::span<const ValueId> operands(ValueId v) const {
+        if (is_leaf(v) || is_erased(v)) {
+            return {};
+        }
+        return {operands_.data() + operand_offsets_[v], operand_offsets_[v + 1] - operand_offsets_[v]};
+    }
+
+    uint32_t use_count(ValueId v) const { return use_counts_[v]; }
+
+    // Calls `fn(user)` once per operand slot that refers to v, so a user of the form v * v is
+    // visited twice.
+    template<typename Fn>
+    void for_each_user(ValueId v, Fn&& fn) const {
+        for (ValueId list = user_lists_[v]; list != kNoValue; list = next_merged_[list]) {
+            for (uint32_t i = user_offsets_[list]; i < user_offsets_[list + 1]; ++i) {
+                const ValueId user = users_[i];
+                // Users that were folded or erased since the lists were built no longer count.
+                if (!is_leaf(user) && !is_erased(user)) {
+                    fn(user);
+                }
+            }
+        }
+    }
+
+    T constant_value(ValueId v) const { return constants_[payloads_[v]]; }
+    // Constants whose value can change after optimization, which passes must not fold.
+    bool is_pinned(ValueId v) const { return ops_[v] == Op::CONSTANT && pinned_constants_[payloads_[v]]; }
+    const std::string& variable_name(ValueId v) const { return variable_nodes_[payloads_[v]]->get_var_name(); }
+
+    /**************************************
+                   Rewrites
+    ***************************************/
+    // Pins the constants lowered from `leaves`, e.g. the parameters being trained. Leaves that
+    // aren't in the graph are ignored.
+    void pin(const std::vector<ExpressionPtr<T>>& leaves) {
+        std::unordered_set<const Node<T>*> nodes;
+        for (const auto& leaf : leaves) {
+            nodes.insert(leaf.get());
+        }
+        for (size_t c = 0; c < constant_nodes_.size(); ++c) {
+            if (constant_nodes_[c] && nodes.contains(constant_nodes_[c])) {
+                pinned_constants_[c] = true;
+            }
+        }
+    }
+
+    // Points every use of `from` at `to` instead. `to` must come before all of `from`'s users,
+    // which holds whenever to < from.
+    void replace_all_uses(ValueId from, ValueId to) {
+        if (from == to) {
+            return;
+        }
+        for_each_user(from, [&](ValueId user) {
+            ValueId* slot = operands_.data() + operand_offsets_[user];
+            while (*slot != from) {
+                ++slot;
+            }
+            *slot = to;
+        });
+        use_counts_[to] += use_counts_[from];
+        use_counts_[from] = 0;
+        if (root_ == from) {
+            root_ = to;
+        }
+
+        // Splice from's chain of user lists onto the end of to's.
+        if (user_lists_[from] != kNoValue) {
+            if (user_lists_[to] == kNoValue) {
+                user_lists_[to] = user_lists_[from];
+            } else {
+                next_merged_[last_merged_[to]] = user_lists_[from];
+            }
+            last_merged_[to] = last_merged_[from];
+            user_lists_[from] = kNoValue;
+        }
+    }
+
+    // Turns v into a constant leaf holding `value`, dropping its operands' uses.
+    void fold_to_constant(ValueId v, T value) {
+        release_operands(v);
+        ops_[v] = Op::CONSTANT;
+        payloads_[v] = static_cast<uint32_t>(constants_.size());
+        constants_.push_back(value);
+        constant_nodes_.push_back(nullptr);
+        pinned_constants_.push_back(false);
+    }
+
+    // Deletes a value with no remaining uses.
+    void erase(ValueId v) {
+        if (use_counts_[v] != 0 || v == root_) {
+            throw std::runtime_error("Cannot erase value " + std::to_string(v) + ", it is still used");
+        }
+        release_operands(v);
+        ops_[v] = Op::UNKNOWN;
+        --live_count_;
+    }
+
+    // Renumbers the live values densely (keeping their order) and rebuilds the operand and
+    // user lists. Invalidates all ValueIds held outside the IR.
+    void compact() {
+        std::vector<ValueId> remap(size(), kNoValue);
+        IR compacted;
+        for (ValueId v = 0; v < size(); ++v) {
+            if (is_erased(v)) {
+                continue;
+            }
+            if (ops_[v] == Op::CONSTANT) {
+                remap[v] = compacted.add_constant(constants_[payloads_[v]], constant_nodes_[payloads_[v]],
+                                                  pinned_constants_[payloads_[v]]);
+            } else if (ops_[v] == Op::VARIABLE) {
+                remap[v] = compacted.add_variable(variable_nodes_[payloads_[v]]);
+            } else {
+                ValueId mapped[2];
+                const auto inputs = operands(v);
+                for (size_t i = 0; i < inputs.size(); ++i) {
+                    mapped[i] = remap[inputs[i]];
+                }
+                remap[v] = compacted.add_op(ops_[v], std::span{mapped, inputs.size()});
+            }
+        }
+        compacted.root_ = remap[root_];
+        compacted.build_users();
+        *this = std::move(compacted);
+    }
+
+private:
+    IR() = default;
+
+    static bool is_leaf_node(const Node<T>& node) {
+        // Constants are leaves even if they still hold on to their (folded) inputs, and so are
+        // nodes without inputs whatever their op (e.g. Node's unary negation).
+        return node.get_op() == Op::CONSTANT || node.get_op() == Op::VARIABLE || node.get_inputs().empty();
+    }
+
+    ValueId add_value(Op op, uint32_t payload) {
+        const ValueId id = static_cast<ValueId>(ops_.size());
+        ops_.push_back(op);
+        payloads_.push_back(payload);
+        use_counts_.push_back(0);
+        operand_offsets_.push_back(static_cast<uint32_t>(operands_.size()));
+        ++live_count_;
+        return id;
+    }
+
+    ValueId add_constant(T value, Node<T>* node, bool pinned = false) {
+        const ValueId id = add_value(Op::CONSTANT, static_cast<uint32_t>(constants_.size()));
+        constants_.push_back(value);
+        constant_nodes_.push_back(node);
+        pinned_constants_.push_back(pinned);
+        return id;
+    }
+
+    ValueId add_variable(Node<T>* node) {
+        const ValueId id = add_value(Op::VARIABLE, static_cast<uint32_t>(variable_nodes_.size()));
+        variable_nodes_.push_back(node);
+        return id;
+    }
+
+    ValueId add_op(Op op, std::span<const ValueId> operands) {
+        const ValueId id = add_value(op, 0);
+        for (ValueId operand : operands) {
+            operands_.push_back(operand);
+            ++use_counts_[operand];
+        }
+        return id;
+    }
+
+    // Closes the operand CSR and builds the user CSR from it (counting sort by operand).
+    void build_users() {
+        const size_t n = size();
+        operand_offsets_.push_back(static_cast<uint32_t>(operands_.size()));
+        user_offsets_.assign(n + 1, 0);
+        for (ValueId v = 0; v < n; ++v) {
+            for (ValueId operand : operands(v)) {
+                ++user_offsets_[operand + 1];
+            }
+        }
+        for (size_t v = 0; v < n; ++v) {
+            user_offsets_[v + 1] += user_offsets_[v];
+        }
+        users_.resize(user_offsets_[n]);
+        std::vector<uint32_t> cursor(user_offsets_.begin(), user_offsets_.end() - 1);
+        for (ValueId v = 0; v < n; ++v) {
+            for (ValueId operand : operands(v)) {
+                users_[cursor[operand]++] = v;
+            }
+        }
+
+        user_lists_.resize(n);
+        last_merged_.resize(n);
+        for (ValueId v = 0; v < n; ++v) {
+            user_lists_[v] = v;
+            last_merged_[v] = v;
+        }
+        next_merged_.assign(n, kNoValue);
+    }
+
+    void release_operands(ValueId v) {
+        for (ValueId operand : operands(v)) {
+            --use_counts_[operand];
+        }
+    }
+
+    std::vector<bool> reachable_from_root() const {
+        std::vector<bool> needed(size(), false);
+        needed[root_] = true;
+        for (ValueId v = static_cast<ValueId>(size()); v-- > 0;) {
+            if (needed[v]) {
+                for (ValueId operand : operands(v)) {
+                    needed[operand] = true;
+                }
+            }
+        }
+        return needed;
+    }
+
+    // Per value, indexed by ValueId. `payloads_` indexes constants_/constant_nodes_ for
+    // constants and variable_nodes_ for variables.
+    std::vector<Op> ops_;
+    std::vector<uint32_t> payloads_;
+    std::vector<uint32_t> use_counts_;
+
+    // CSR operand lists: operands of v are operands_[operand_offsets_[v] .. operand_offsets_[v + 1]).
+    std::vector<uint32_t> operand_offsets_;
+    std::vector<ValueId> operands_;
+
+    // CSR user lists, one entry per operand slot, built once by build_users(). Lists are
+    // never copied: the users of v are the chain of CSR lists starting at user_lists_[v]
+    // (initially v's own) and linked through next_merged_, and replace_all_uses splices
+    // chains in O(1) using last_merged_ as the tail.
+    std::vector<uint32_t> user_offsets_;
+    std::vector<ValueId> users_;
+    std::vector<ValueId> user_lists_;
+    std::vector<ValueId> next_merged_;
+    std::vector<ValueId> last_merged_;
+
+    std::vector<T> constants_;
+    // Leaves of the lowered graph, which must outlive the IR. Raw pointers so lowering doesn't
+    // touch every leaf's reference count; raise() takes shared ownership again.
+    std::vector<Node<T>*> constant_nodes_;  // null for constants made by folding
+    std::vector<bool> pinned_constants_;
+    std::vector<Node<T>*> variable_nodes_;
+
+    ValueId root_{kNoValue};
+    size_t live_count_{0};
+};
+
+} // grad::optimizer
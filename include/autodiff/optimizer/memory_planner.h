@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "autodiff/node.h"
+#include "autodiff/optimizer/ir.h"
+
+namespace grad::optimizer {
+
+/**
+Static memory plan for running an IR forward and backward with every intermediate value
+and adjoint in a buffer from a shared pool, instead of one buffer per node for the graph's
+whole lifetime.
+
+The schedule is the IR's id order: value v is computed at forward step v, and its backward
+rule runs at step backward_step(v) = 2n - 1 - v, so backward walks the ids in reverse.
+
+    - A value is live from its own forward step until its last reader: the forward steps of
+      its users, plus the backward steps of users whose backward rule reads it (MUL reads
+      both inputs, ADD neither; see backward_reads) and its own backward step if its rule
+      reads the output (EXP, TANH, ...). The root's value is live to the end of forward.
+    - An adjoint is live from the first backward step that accumulates into it (its
+      highest-id user; step n for the root) until its own backward step. Leaf adjoints are
+      results, so they stay live to the end.
+
+Leaf values (constants and variables) live in caller-owned storage and aren't planned.
+Every buffer holds one value for each of `lanes` lanes, so all buffers have the same size;
+packing them is interval graph coloring, which a sweep over the steps that always reuses a
+freed buffer solves optimally: the pool is exactly as large as the most buffers live at
+once.
+
+Run DeadCodeElimPass first: values the root doesn't use would otherwise still be planned.
+*/
+struct LiveInterval {
+    // Inclusive steps. start > end for values that aren't planned.
+    uint32_t start{1};
+    uint32_t end{0};
+
+    bool empty() const { return start > end; }
+};
+
+inline constexpr uint32_t kNoBuffer = UINT32_MAX;
+
+struct MemoryPlanOptions {
+    // Plan adjoints and keep what backward reads alive; otherwise forward only.
+    bool backward{true};
+    size_t lanes{1};
+};
+
+// What an op's backward rule reads besides the incoming adjoint, matching ExecutionPlan.
+struct BackwardReads {
+    bool inputs;
+    bool output;
+};
+
+inline BackwardReads backward_reads(Op op) {
+    switch (op) {
+        case Op::MUL:
+        case Op::DIV:
+        case Op::SIN:
+        case Op::COS:
+        case Op::LN:
+            return {true, false};
+        case Op::EXP:
+        case Op::TAN:
+        case Op::TANH:
+            return {false, true};
+        case Op::POW:
+            return {true, true};
+        default:
+            // ADD, SUB and NEGATE only pass the adjoint on.
+            return {false, false};
+    }
+}
+
+struct MemoryPlan {
+    uint32_t value_count{0};
+    size_t buffer_bytes{0};
+    uint32_t buffer_count{0};
+    // Number of planned values and adjoints, i.e. buffers without reuse.
+    uint32_t planned_count{0};
+
+    // Indexed by ValueId.
+    std::vector<LiveInterval> value_intervals;
+    std::vector<LiveInterval> grad_intervals;
+    std::vector<uint32_t> value_buffers;
+    std::vector<uint32_t> grad_buffers;
+
+    uint32_t forward_step(ValueId v) const { return v; }
+    uint32_t backward_step(ValueId v) const { return 2 * value_count - 1 - v; }
+
+    size_t buffer_offset(uint32_t buffer) const { return buffer * buffer_bytes; }
+    size_t planned_bytes() const { return buffer_count * buffer_bytes; }
+    size_t naive_bytes() const { return planned_count * buffer_bytes; }
+
+    std::string summary() const {
+        const size_t saved = naive_bytes() == 0 ? 0 : 100 - planned_bytes() * 100 / naive_bytes();
+        return std::to_string(planned_count) + " buffers in a pool of " + std::to_string(buffer_count) + ": " +
+               std::to_string(planned_bytes()) + " bytes planned vs " + std::to_string(naive_bytes()) +
+               " naive (" + std::to_string(saved) + "% saved)";
+    }
+};
+
+template<Numeric T>
+MemoryPlan plan_memory(const IR<T>& ir, MemoryPlanOptions options = {}) {
+    const uint32_t n = static_cast<uint32_t>(ir.size());
+    MemoryPlan plan;
+    plan.value_count = n;
+    plan.buffer_bytes = sizeof(T) * options.lanes;
+    plan.value_intervals.resize(n);
+    plan.grad_intervals.resize(n);
+    plan.value_buffers.assign(n, kNoBuffer);
+    plan.grad_buffers.assign(n, kNoBuffer);
+    if (n == 0) {
+        return plan;
+    }
+    const uint32_t last_step = options.backward ? 2 * n - 1 : n - 1;
+
+    /**************************************
+               Live intervals
+    ***************************************/
+    // One pass over the users' operand lists: each user extends its operands' intervals.
+    for (ValueId v = 0; v < n; ++v) {
+        if (ir.is_erased(v)) {
+            continue;
+        }
+        if (!ir.is_leaf(v)) {
+            plan.value_intervals[v] = {v, v};
+        }
+        if (options.backward && v == ir.root()) {
+            // Seeded when backward starts.
+            plan.grad_intervals[v] = {n, ir.is_leaf(v) ? last_step : plan.backward_step(v)};
+        }
+    }
+    if (!ir.is_leaf(ir.root())) {
+        plan.value_intervals[ir.root()].end = n - 1;
+    }
+
+    for (ValueId u = 0; u < n; ++u) {
+        const auto operands = ir.operands(u);
+        if (operands.empty()) {
+            continue;
+        }
+        const BackwardReads reads = backward_reads(ir.op(u));
+        const uint32_t u_backward = plan.backward_step(u);
+        if (options.backward && reads.output) {
+            plan.value_intervals[u].end = std::max(plan.value_intervals[u].end, u_backward);
+        }
+        for (ValueId operand : operands) {
+            if (!ir.is_leaf(operand)) {
+                LiveInterval& value = plan.value_intervals[operand];
+                value.end = std::max(value.end, options.backward && reads.inputs ? u_backward : u);
+            }
+            if (options.backward && operand != ir.root()) {
+                // Users come in increasing id order, so the last one runs first in backward
+                // and starts the adjoint. Leaf adjoints are results and stay to the end.
+                plan.grad_intervals[operand] = {u_backward,
+                                                ir.is_leaf(operand) ? last_step : plan.backward_step(operand)};
+            }
+        }
+    }
+
+    /**************************************
+                  Packing
+    ***************************************/
+    // Bucket interval starts and ends by step (counting sort), then sweep the steps: buffers
+    // whose interval ended before this step go back on the free list, and each interval
+    // starting here takes the most recently freed buffer, which is the likeliest to be in cache.
+    struct Bucketed {
+        std::vector<uint32_t> offsets;
+        std::vector<std::pair<bool, ValueId>> items;  // (is adjoint, value)
+    };
+    auto bucket = [&](auto step_of) {
+        Bucketed b;
+        b.offsets.assign(last_step + 2, 0);
+        for (ValueId v = 0; v < n; ++v) {
+            for (bool grad : {false, true}) {
+                const LiveInterval& interval = grad ? plan.grad_intervals[v] : plan.value_intervals[v];
+                if (!interval.empty()) {
+                    ++b.offsets[step_of(interval) + 1];
+                }
+            }
+        }
+        for (uint32_t s = 0; s <= last_step; ++s) {
+            b.offsets[s + 1] += b.offsets[s];
+        }
+        b.items.resize(b.offsets[last_step + 1]);
+        std::vector<uint32_t> cursor(b.offsets.begin(), b.offsets.end() - 1);
+        for (ValueId v = 0; v < n; ++v) {
+            for (bool grad : {false, true}) {
+                const LiveInterval& interval = grad ? plan.grad_intervals[v] : plan.value_intervals[v];
+                if (!interval.empty()) {
+                    b.items[cursor[step_of(interval)]++] = {grad, v};
+                }
+            }
+        }
+        return b;
+    };
+    const Bucketed starts = bucket([](const LiveInterval& i) { return i.start; });
+    const Bucketed ends = bucket([](const LiveInterval& i) { return i.end; });
+    plan.planned_count = static_cast<uint32_t>(starts.items.size());
+
+    std::vector<uint32_t> free_buffers;
+    auto buffer_of = [&](bool grad, ValueId v) -> uint32_t& {
+        return grad ? plan.grad_buffers[v] : plan.value_buffers[v];
+    };
+    for (uint32_t s = 0; s <= last_step; ++s) {
+        if (s > 0) {
+            for (uint32_t i = ends.offsets[s - 1]; i < ends.offsets[s]; ++i) {
+                free_buffers.push_back(buffer_of(ends.items[i].first, ends.items[i].second));
+            }
+        }
+        for (uint32_t i = starts.offsets[s]; i < starts.offsets[s + 1]; ++i) {
+            uint32_t buffer;
+            if (free_buffers.empty()) {
+                buffer = plan.buffer_count++;
+            } else {
+                buffer = free_buffers.back();
+                free_buffers.pop_back();
+            }
+            buffer_of(starts.items[i].first, starts.items[i].second) = buffer;
+        }
+    }
+    return plan;
+}
+
+} // grad::optimizer
@@ -1,18 +1,24 @@
 #pragma once
 
 #include "autodiff/node.h"
+#include "autodiff/optimizer/ir.h"
 #include "autodiff/optimizer/passes/pass.h"
 
 namespace grad::optimizer {
 
+// Lowers `input_graph` to the IR, runs `passes` over it in order and raises a new graph.
+// The input graph is left untouched, apart from sharing its leaf nodes with the result.
+// Constants in `pinned` are never folded away, so pass the trainable parameters (e.g.
+// ParameterBuffer::parameters()) to keep updating them through the optimized graph.
 template<Numeric T>
-ExpressionPtr<T> optimize(ExpressionPtr<T> input_graph, const std::vector<std::shared_ptr<Pass<T>>>& passes) {
-    // Need a real deep copy here, don't have that right now.
-    ExpressionPtr<T> new_graph = input_graph;
+ExpressionPtr<T> optimize(const ExpressionPtr<T>& input_graph, const std::vector<std::shared_ptr<Pass<T>>>& passes,
+                          const std::vector<ExpressionPtr<T>>& pinned = {}) {
+    IR<T> ir = IR<T>::lower(input_graph);
+    ir.pin(pinned);
     for (const auto& pass : passes) {
-        new_graph = pass->apply_pass(new_graph);
+        pass->apply_pass(ir);
     }
-    return new_graph;
+    return ir.raise();
 }
 
 } // grad::optimizer
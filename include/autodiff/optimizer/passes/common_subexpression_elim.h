@@ -1,18 +1,65 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+
 #include "autodiff/node.h"
+#include "autodiff/optimizer/ir.h"
+#include "autodiff/optimizer/passes/pass.h"
 
 namespace grad::optimizer {
 
+/**
+Merges values that apply the same op to the same operands. Leaves are never merged: equal
+constants can still be distinct trainable parameters, and variables are already shared by
+name when lowering.
+*/
 template<Numeric T>
 class CommonSubexpressionElimPass : public Pass<T> {
 public:
     ~CommonSubexpressionElimPass() override = default;
 
-    ExpressionPtr<T> apply_pass(ExpressionPtr<T> expression) override {
-        // TODO
-        return expression;
+    void apply_pass(IR<T>& ir) override {
+        std::unordered_map<Key, ValueId, KeyHash> seen;
+        seen.reserve(ir.live_count());
+        // Forward sweep: operands were canonicalized before their users are looked at, so one
+        // pass also catches duplicates that only appear after their inputs were merged.
+        for (ValueId v = 0; v < ir.size(); ++v) {
+            if (ir.is_leaf(v) || ir.is_erased(v)) {
+                continue;
+            }
+            const auto operands = ir.operands(v);
+            Key key{ir.op(v), operands[0], operands.size() > 1 ? operands[1] : kNoValue};
+            if (is_commutative(key.op) && key.b < key.a) {
+                std::swap(key.a, key.b);
+            }
+            auto [it, inserted] = seen.emplace(key, v);
+            if (!inserted) {
+                ir.replace_all_uses(v, it->second);
+            }
+        }
     }
+
+private:
+    struct Key {
+        Op op;
+        ValueId a;
+        ValueId b;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t h = (static_cast<uint64_t>(key.a) << 32) | key.b;
+            h ^= static_cast<uint64_t>(key.op) * 0x9e3779b97f4a7c15ULL;
+            return std::hash<uint64_t>{}(h);
+        }
+    };
+
+    static bool is_commutative(Op op) { return op == Op::ADD || op == Op::MUL; }
 };
 
 } // grad::optimizer
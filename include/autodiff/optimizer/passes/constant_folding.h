@@ -1,11 +1,8 @@
 #pragma once
 
-#include <iostream>
-
-#include <algorithm>
-
 #include "autodiff/node.h"
-#include "autodiff/graph_helpers.h"
+#include "autodiff/optimizer/ir.h"
+#include "autodiff/optimizer/passes/pass.h"
 
 namespace grad::optimizer {
 
@@ -14,55 +11,31 @@ class ConstantFoldingPass : public Pass<T> {
 public:
     ~ConstantFoldingPass() override = default;
 
-    ExpressionPtr<T> apply_pass(ExpressionPtr<T> expression) override {
-        // Can apply this pass in two phases:
-        // 1st phase - marking:
-        //      In this phase, just mark nodes as constant if they are constant or if all
-        //      their inputs are provably constant.
-        // 2nd phase - folding: In this phase, actually fold the constants by evaluating the constant nodes.
-        mark_as_const_pass(expression);
-        fold_constants(expression);
-        return expression;
-    }
-
-private:
-    void mark_as_const_pass(ExpressionPtr<T> expression) {
-        auto helper = [&](this const auto &self, ExpressionPtr<T> expression) -> bool {
-            if (expression->get_op() == Op::CONSTANT) {
-                return true;
+    void apply_pass(IR<T>& ir) override {
+        // Ids are topologically ordered, so by the time we reach a value its operands have
+        // already been folded if they could be: one forward sweep marks and folds at once.
+        // The folded-away operands stay in the IR until dead code elimination removes them.
+        // TODO - have some cost function so that we don't fold everything
+        for (ValueId v = 0; v < ir.size(); ++v) {
+            if (ir.is_leaf(v) || ir.is_erased(v)) {
+                continue;
             }
-
-            bool all_const_inputs = expression->get_inputs().size() > 0;
-            for (const auto& input : expression->get_inputs()) {
-                all_const_inputs &= self(input);
+            const auto operands = ir.operands(v);
+            bool all_const_inputs = !operands.empty();
+            for (ValueId operand : operands) {
+                // Pinned constants (trainable parameters) may change after optimizing.
+                all_const_inputs &= ir.op(operand) == Op::CONSTANT && !ir.is_pinned(operand);
             }
-
-            if (all_const_inputs) {
-                expression->mark_as_const();
-                return true;
+            if (!all_const_inputs) {
+                continue;
             }
 
-            return false;
-
-        }(expression);
-    }
-
-    void fold_constants(ExpressionPtr<T> expression) {
-        graph::traverse<graph::TraversalType::DFS, ExpressionPtr<T>>(expression,
-            [](const ExpressionPtr<T>& node) {
-                return node->get_inputs();
-            },
-
-            [](ExpressionPtr<T> node) {
-            if (node->get_op() == Op::CONSTANT) {
-                // TODO - Cache evaluations so we don't keep recomputing this value.
-                // TODO - have some cost function so that we don't fold everything
-                node->evaluate();
-                // Inputs are no longer necessary if we have proven that this node is constant
-                // and have evaluated it (Other nodes that depend on the same inputs will still persist)
-                node->clear_inputs();
-            }
-        });
+            const T value = operands.size() == 1
+                                ? evaluate_unary_op(ir.op(v), ir.constant_value(operands[0]))
+                                : evaluate_binary_op(ir.op(v), ir.constant_value(operands[0]),
+                                                     ir.constant_value(operands[1]));
+            ir.fold_to_constant(v, value);
+        }
     }
 };
 
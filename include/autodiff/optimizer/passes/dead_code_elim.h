@@ -0,0 +1,27 @@
+#pragma once
+
+#include "autodiff/node.h"
+#include "autodiff/optimizer/ir.h"
+#include "autodiff/optimizer/passes/pass.h"
+
+namespace grad::optimizer {
+
+// Erases every value the root doesn't depend on, then compacts the IR's ids.
+template<Numeric T>
+class DeadCodeElimPass : public Pass<T> {
+public:
+    ~DeadCodeElimPass() override = default;
+
+    void apply_pass(IR<T>& ir) override {
+        // Users come after their operands, so a backward sweep sees every value after all of
+        // its users have been erased: a use count of zero then means dead for good.
+        for (ValueId v = static_cast<ValueId>(ir.size()); v-- > 0;) {
+            if (!ir.is_erased(v) && v != ir.root() && ir.use_count(v) == 0) {
+                ir.erase(v);
+            }
+        }
+        ir.compact();
+    }
+};
+
+} // grad::optimizer
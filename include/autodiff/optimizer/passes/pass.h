@@ -1,14 +1,17 @@
 #pragma once
 
 #include "autodiff/node.h"
+#include "autodiff/optimizer/ir.h"
 
 namespace grad::optimizer {
 
+// Passes rewrite the IR in place; optimize() lowers the graph once, runs every pass on the
+// same IR and raises the result.
 template<Numeric T>
 class Pass {
 public:
     virtual ~Pass() = default;
-    virtual ExpressionPtr<T> apply_pass(ExpressionPtr<T> expression) = 0;
+    virtual void apply_pass(IR<T>& ir) = 0;
 };
 
 } // grad::optimizer
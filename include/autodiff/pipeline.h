@@ -0,0 +1,526 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "autodiff/execution_plan.h"
+#include "autodiff/serialization.h"
+
+/**
+Streaming batch evaluation of one fixed graph over a row-oriented input file.
+
+    reader (thread) --> [2 input chunks] --> evaluate (caller) --> [2 output chunks] --> writer (thread)
+
+Chunks ping-pong between the stages, so parsing the next chunk and writing the previous one
+overlap with evaluating the current one. Chunk buffers are allocated once per run() and the
+channels between the stages are fixed rings, so nothing is allocated per chunk. Each chunk is
+evaluated through a BatchExecutionPlan, so the graph is never rebuilt or mutated.
+
+    grad::pipeline::CsvRowReader<double> reader{"rows.csv", 2, true};
+    grad::pipeline::CsvRowWriter<double> writer{"scores.csv"};
+    grad::pipeline::BatchPipeline<double> pipeline{view, {{0, x_index}, {1, y_index}}, {.with_gradients = true}};
+    pipeline.run(reader, writer);
+*/
+namespace grad::pipeline {
+
+namespace detail {
+
+class FileDescriptor {
+   public:
+    FileDescriptor(const std::string& path, int flags) : fd_{::open(path.c_str(), flags, 0644)} {
+        if (fd_ < 0) {
+            throw std::runtime_error("Could not open " + path);
+        }
+    }
+    ~FileDescriptor() { ::close(fd_); }
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    // Reads until `size` bytes or EOF; returns the number of bytes read.
+    size_t read_fully(char* out, size_t size) const {
+        size_t total = 0;
+        while (total < size) {
+            const ssize_t n = ::read(fd_, out + total, size - total);
+            if (n < 0) {
+                throw std::runtime_error("Read failed");
+            }
+            if (n == 0) {
+                break;
+            }
+            total += static_cast<size_t>(n);
+        }
+        return total;
+    }
+
+    void write_fully(const char* data, size_t size) const {
+        while (size > 0) {
+            const ssize_t n = ::write(fd_, data, size);
+            if (n < 0) {
+                throw std::runtime_error("Write failed");
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+   private:
+    int fd_;
+};
+
+// Sizes and counts that would otherwise divide by zero or never make progress.
+inline size_t require_positive(size_t value, const char* what) {
+    if (value == 0) {
+        throw std::invalid_argument(std::string{what} + " must be positive");
+    }
+    return value;
+}
+
+/**
+Blocking queue between pipeline stages, on a fixed ring of `capacity` slots so passing items
+never allocates. close() wakes up every waiter; pop() then drains what is left and returns
+nullopt.
+*/
+template <typename Item>
+class Channel {
+   public:
+    explicit Channel(size_t capacity) : items_(require_positive(capacity, "Channel capacity")) {}
+
+    // The pipeline circulates a fixed set of chunks, so a full ring is a logic error rather
+    // than something to wait on.
+    void push(Item item) {
+        {
+            std::lock_guard lock{mutex_};
+            if (closed_) {
+                return;
+            }
+            if (count_ == items_.size()) {
+                throw std::logic_error("Channel is full");
+            }
+            items_[(head_ + count_) % items_.size()] = std::move(item);
+            ++count_;
+        }
+        available_.release();
+    }
+
+    std::optional<Item> pop() {
+        // One token per queued item, plus one once the channel is closed.
+        available_.acquire();
+        std::lock_guard lock{mutex_};
+        if (count_ == 0) {
+            // Closed and drained: hand the wake-up on to the next waiter.
+            available_.release();
+            return std::nullopt;
+        }
+        Item item = std::move(items_[head_]);
+        head_ = (head_ + 1) % items_.size();
+        --count_;
+        return item;
+    }
+
+    void close() {
+        {
+            std::lock_guard lock{mutex_};
+            if (closed_) {
+                return;
+            }
+            closed_ = true;
+        }
+        available_.release();
+    }
+
+   private:
+    std::mutex mutex_;
+    std::counting_semaphore<> available_{0};
+    std::vector<Item> items_;
+    size_t head_{0};
+    size_t count_{0};
+    bool closed_{false};
+};
+
+}  // namespace detail
+
+/**************************************
+               Readers
+***************************************/
+
+/**
+Rows of `num_columns` raw T values, back to back, in host byte order.
+*/
+template <Numeric T>
+class BinaryRowReader {
+   public:
+    BinaryRowReader(const std::string& path, size_t num_columns)
+        : file_{path, O_RDONLY}, num_columns_{detail::require_positive(num_columns, "num_columns")} {}
+
+    size_t num_columns() const { return num_columns_; }
+
+    // Fills `rows` (a multiple of num_columns) and returns the number of rows read.
+    size_t read_rows(std::span<T> rows) {
+        const size_t bytes = file_.read_fully(reinterpret_cast<char*>(rows.data()), rows.size_bytes());
+        if (bytes % (num_columns_ * sizeof(T)) != 0) {
+            throw std::runtime_error("Binary input ends with a partial row");
+        }
+        return bytes / (num_columns_ * sizeof(T));
+    }
+
+   private:
+    detail::FileDescriptor file_;
+    size_t num_columns_;
+};
+
+/**
+Comma separated rows of exactly `num_columns` numbers. Input is read through a fixed-size
+buffer; a line split across two reads is carried over to the next one.
+*/
+template <Numeric T>
+class CsvRowReader {
+   public:
+    CsvRowReader(const std::string& path, size_t num_columns, bool skip_header = false,
+                 size_t buffer_bytes = 1 << 20)
+        : file_{path, O_RDONLY},
+          num_columns_{detail::require_positive(num_columns, "num_columns")},
+          skip_header_{skip_header},
+          buffer_(detail::require_positive(buffer_bytes, "buffer_bytes")) {}
+
+    size_t num_columns() const { return num_columns_; }
+
+    size_t read_rows(std::span<T> rows) {
+        const size_t max_rows = rows.size() / num_columns_;
+        size_t row = 0;
+        while (row < max_rows) {
+            std::optional<std::string_view> line = next_line();
+            if (!line) {
+                break;
+            }
+            if (skip_header_) {
+                skip_header_ = false;
+                continue;
+            }
+            if (line->empty()) {
+                continue;
+            }
+            parse_line(*line, rows.subspan(row * num_columns_, num_columns_));
+            ++row;
+        }
+        return row;
+    }
+
+   private:
+    std::optional<std::string_view> next_line() {
+        while (true) {
+            const char* begin = buffer_.data() + start_;
+            const char* end = buffer_.data() + end_;
+            if (const char* newline = std::find(begin, end, '\n'); newline != end) {
+                start_ += static_cast<size_t>(newline - begin) + 1;
+                return trim_cr({begin, static_cast<size_t>(newline - begin)});
+            }
+            if (eof_) {
+                if (begin == end) {
+                    return std::nullopt;
+                }
+                start_ = end_;
+                return trim_cr({begin, static_cast<size_t>(end - begin)});
+            }
+            refill();
+        }
+    }
+
+    void refill() {
+        // Slide the partial line to the front, then top the buffer up.
+        const size_t carried = end_ - start_;
+        std::memmove(buffer_.data(), buffer_.data() + start_, carried);
+        start_ = 0;
+        end_ = carried;
+        if (end_ == buffer_.size()) {
+            buffer_.resize(buffer_.size() * 2);
+        }
+        const size_t n = file_.read_fully(buffer_.data() + end_, buffer_.size() - end_);
+        end_ += n;
+        eof_ = n == 0;
+    }
+
+    static std::string_view trim_cr(std::string_view line) {
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        return line;
+    }
+
+    void parse_line(std::string_view line, std::span<T> out) const {
+        const char* cursor = line.data();
+        const char* end = line.data() + line.size();
+        for (size_t column = 0; column < num_columns_; ++column) {
+            while (cursor < end && *cursor == ' ') ++cursor;
+            auto [next, error] = std::from_chars(cursor, end, out[column]);
+            if (error != std::errc{}) {
+                throw std::runtime_error("Could not parse CSV line: " + std::string{line});
+            }
+            cursor = next;
+            while (cursor < end && *cursor == ' ') ++cursor;
+            const bool last = column + 1 == num_columns_;
+            if (last ? cursor != end : (cursor == end || *cursor != ',')) {
+                throw std::runtime_error("Expected " + std::to_string(num_columns_) +
+                                         " columns in CSV line: " + std::string{line});
+            }
+            ++cursor;
+        }
+    }
+
+    detail::FileDescriptor file_;
+    size_t num_columns_;
+    bool skip_header_;
+    std::vector<char> buffer_;
+    size_t start_{0};
+    size_t end_{0};
+    bool eof_{false};
+};
+
+/**************************************
+               Writers
+***************************************/
+
+template <Numeric T>
+class BinaryRowWriter {
+   public:
+    explicit BinaryRowWriter(const std::string& path) : file_{path, O_WRONLY | O_CREAT | O_TRUNC} {}
+
+    void write_rows(std::span<const T> rows, size_t /*num_columns*/) {
+        file_.write_fully(reinterpret_cast<const char*>(rows.data()), rows.size_bytes());
+    }
+
+   private:
+    detail::FileDescriptor file_;
+};
+
+template <Numeric T>
+class CsvRowWriter {
+   public:
+    explicit CsvRowWriter(const std::string& path) : file_{path, O_WRONLY | O_CREAT | O_TRUNC} {}
+
+    void write_rows(std::span<const T> rows, size_t num_columns) {
+        // Shortest round-trippable representation, at most ~32 chars per value.
+        text_.resize(rows.size() * 32);
+        char* cursor = text_.data();
+        for (size_t i = 0; i < rows.size(); ++i) {
+            cursor = std::to_chars(cursor, text_.data() + text_.size(), rows[i]).ptr;
+            *cursor++ = (i + 1) % num_columns == 0 ? '\n' : ',';
+        }
+        file_.write_fully(text_.data(), static_cast<size_t>(cursor - text_.data()));
+    }
+
+   private:
+    detail::FileDescriptor file_;
+    std::vector<char> text_;
+};
+
+/**************************************
+               Pipeline
+***************************************/
+
+struct ColumnBinding {
+    size_t column;
+    size_t variable;
+};
+
+struct PipelineOptions {
+    // Rows per chunk handed between the reader, evaluator and writer.
+    size_t chunk_rows{4096};
+    // Rows evaluated together by the batch plan; bounds its scratch memory.
+    size_t batch_lanes{256};
+    // Also emit d(output)/d(variable) for every bound variable, in binding order.
+    bool with_gradients{false};
+    // FAST trades a few ULP on exp/log/sin/cos/tanh for SIMD kernels (see kernels/).
+    kernels::Accuracy accuracy{kernels::Accuracy::EXACT};
+};
+
+template <typename R, typename T>
+concept RowReader = requires(R reader, std::span<T> rows) {
+    { reader.num_columns() } -> std::convertible_to<size_t>;
+    { reader.read_rows(rows) } -> std::convertible_to<size_t>;
+};
+
+template <typename W, typename T>
+concept RowWriter = requires(W writer, std::span<const T> rows, size_t num_columns) {
+    writer.write_rows(rows, num_columns);
+};
+
+/**
+Evaluates a serialized graph once per input row. Every graph variable must be bound to an
+input column. Output rows are `value` followed, with `with_gradients`, by the gradient of
+the value w.r.t. each bound variable.
+*/
+template <Numeric T>
+class BatchPipeline {
+   public:
+    BatchPipeline(const serialization::GraphView<T>& view, std::vector<ColumnBinding> bindings,
+                  PipelineOptions options = {})
+        : plan_{view, detail::require_positive(options.batch_lanes, "batch_lanes"), options.accuracy},
+          bindings_{std::move(bindings)},
+          options_{options} {
+        detail::require_positive(options.chunk_rows, "chunk_rows");
+        std::vector<bool> bound(plan_.variable_count(), false);
+        for (const ColumnBinding& binding : bindings_) {
+            if (binding.variable >= plan_.variable_count()) {
+                throw std::runtime_error("Binding refers to unknown variable " + std::to_string(binding.variable));
+            }
+            bound[binding.variable] = true;
+        }
+        for (size_t i = 0; i < bound.size(); ++i) {
+            if (!bound[i]) {
+                throw std::runtime_error("Variable " + std::string{plan_.variable_name(i)} +
+                                         " is not bound to an input column");
+            }
+        }
+    }
+
+    size_t output_columns() const { return 1 + (options_.with_gradients ? bindings_.size() : 0); }
+
+    // Streams every row from `reader` to `writer`. Returns the number of rows processed.
+    template <RowReader<T> Reader, RowWriter<T> Writer>
+    size_t run(Reader& reader, Writer& writer) {
+        const size_t input_columns = reader.num_columns();
+        for (const ColumnBinding& binding : bindings_) {
+            if (binding.column >= input_columns) {
+                throw std::runtime_error("Binding refers to column " + std::to_string(binding.column) +
+                                         " but input only has " + std::to_string(input_columns));
+            }
+        }
+
+        struct Chunk {
+            std::vector<T> data;
+            size_t rows{0};
+        };
+        constexpr size_t kBuffers = 2;
+        std::vector<Chunk> inputs(kBuffers);
+        std::vector<Chunk> outputs(kBuffers);
+        for (size_t i = 0; i < kBuffers; ++i) {
+            inputs[i].data.resize(options_.chunk_rows * input_columns);
+            outputs[i].data.resize(options_.chunk_rows * output_columns());
+        }
+
+        detail::Channel<Chunk*> free_inputs{kBuffers}, full_inputs{kBuffers}, free_outputs{kBuffers},
+            full_outputs{kBuffers};
+        for (size_t i = 0; i < kBuffers; ++i) {
+            free_inputs.push(&inputs[i]);
+            free_outputs.push(&outputs[i]);
+        }
+
+        std::exception_ptr reader_error, writer_error;
+
+        std::thread reader_thread{[&] {
+            try {
+                while (std::optional<Chunk*> chunk = free_inputs.pop()) {
+                    (*chunk)->rows = reader.read_rows((*chunk)->data);
+                    if ((*chunk)->rows == 0) {
+                        break;
+                    }
+                    full_inputs.push(*chunk);
+                }
+            } catch (...) {
+                reader_error = std::current_exception();
+            }
+            full_inputs.close();
+        }};
+
+        std::thread writer_thread{[&] {
+            try {
+                while (std::optional<Chunk*> chunk = full_outputs.pop()) {
+                    writer.write_rows(std::span<const T>{(*chunk)->data.data(), (*chunk)->rows * output_columns()},
+                                      output_columns());
+                    free_outputs.push(*chunk);
+                }
+            } catch (...) {
+                writer_error = std::current_exception();
+                free_outputs.close();
+            }
+        }};
+
+        size_t total_rows = 0;
+        std::exception_ptr compute_error;
+        try {
+            while (std::optional<Chunk*> input = full_inputs.pop()) {
+                std::optional<Chunk*> output = free_outputs.pop();
+                if (!output) {
+                    break;
+                }
+                evaluate_chunk(**input, input_columns, **output);
+                total_rows += (*input)->rows;
+                free_inputs.push(*input);
+                full_outputs.push(*output);
+            }
+        } catch (...) {
+            compute_error = std::current_exception();
+        }
+
+        // Unblock both stages whether we finished or bailed out.
+        free_inputs.close();
+        full_inputs.close();
+        full_outputs.close();
+        reader_thread.join();
+        writer_thread.join();
+
+        for (const std::exception_ptr& error : {compute_error, reader_error, writer_error}) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        return total_rows;
+    }
+
+   private:
+    template <typename Chunk>
+    void evaluate_chunk(const Chunk& input, size_t input_columns, Chunk& output) {
+        const size_t out_columns = output_columns();
+        output.rows = input.rows;
+
+        for (size_t first = 0; first < input.rows; first += plan_.max_lanes()) {
+            const size_t lanes = std::min(plan_.max_lanes(), input.rows - first);
+            const T* rows = input.data.data() + first * input_columns;
+
+            // Row-major input columns -> per-variable lanes.
+            for (const ColumnBinding& binding : bindings_) {
+                std::span<T> lane = plan_.variable_lanes(binding.variable);
+                for (size_t l = 0; l < lanes; ++l) {
+                    lane[l] = rows[l * input_columns + binding.column];
+                }
+            }
+
+            plan_.evaluate(lanes);
+            T* out = output.data.data() + first * out_columns;
+            std::span<const T> values = plan_.root_values(lanes);
+            for (size_t l = 0; l < lanes; ++l) {
+                out[l * out_columns] = values[l];
+            }
+
+            if (options_.with_gradients) {
+                plan_.backward(lanes);
+                for (size_t b = 0; b < bindings_.size(); ++b) {
+                    const auto grads = plan_.variable_grads(bindings_[b].variable, lanes);
+                    for (size_t l = 0; l < lanes; ++l) {
+                        out[l * out_columns + 1 + b] = static_cast<T>(grads[l]);
+                    }
+                }
+            }
+        }
+    }
+
+    BatchExecutionPlan<T> plan_;
+    std::vector<ColumnBinding> bindings_;
+    PipelineOptions options_;
+};
+
+}  // namespace grad::pipeline
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+namespace grad::profiling {
+
+/**
+Per-node profiling for evaluate()/get_gradients().
+
+Collection only exists when AUTODIFF_ENABLE_PROFILING is defined (consistently, for every
+translation unit that includes autodiff headers, same as NDEBUG). Otherwise every hook below
+is an empty inline function behind `if constexpr` and compiles to nothing.
+
+Usage:
+    grad::profiling::Session session;
+    expr->evaluate();
+    expr->get_gradients();
+    std::string dot = grad::to_dot(expr, &session.profile());
+*/
+#ifdef AUTODIFF_ENABLE_PROFILING
+inline constexpr bool kEnabled = true;
+#else
+inline constexpr bool kEnabled = false;
+#endif
+
+struct NodeStats {
+    uint64_t forward_calls{0};
+    uint64_t backward_calls{0};
+    // Time spent in the node's own op, excluding its inputs.
+    uint64_t forward_ns{0};
+    uint64_t backward_ns{0};
+    double max_abs_value{0};
+    double max_abs_grad{0};
+
+    uint64_t total_ns() const { return forward_ns + backward_ns; }
+};
+
+// Keyed by node address, so a profile is only meaningful while the graph it was taken on is alive.
+using Profile = std::unordered_map<const void*, NodeStats>;
+
+class Session;
+
+namespace detail {
+inline Session*& active_session() {
+    thread_local Session* session = nullptr;
+    return session;
+}
+}  // namespace detail
+
+/**
+Collects stats for every instrumented run on the current thread while it is alive.
+Sessions nest; the innermost one receives the samples.
+*/
+class Session {
+   public:
+    Session() : previous_{detail::active_session()} { detail::active_session() = this; }
+    ~Session() { detail::active_session() = previous_; }
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    const Profile& profile() const { return profile_; }
+    Profile& profile() { return profile_; }
+    void reset() { profile_.clear(); }
+
+   private:
+    Session* previous_;
+    Profile profile_{};
+};
+
+using TimePoint = std::chrono::steady_clock::time_point;
+
+inline TimePoint now() {
+    if constexpr (kEnabled) {
+        return std::chrono::steady_clock::now();
+    } else {
+        return {};
+    }
+}
+
+template <typename T>
+inline void record_forward(const void* node, TimePoint start, T value) {
+    if constexpr (kEnabled) {
+        Session* session = detail::active_session();
+        if (session == nullptr) {
+            return;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        NodeStats& stats = session->profile()[node];
+        ++stats.forward_calls;
+        stats.forward_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        stats.max_abs_value = std::fmax(stats.max_abs_value, std::fabs(static_cast<double>(value)));
+    }
+}
+
+template <typename T>
+inline void record_backward(const void* node, TimePoint start, T grad) {
+    if constexpr (kEnabled) {
+        Session* session = detail::active_session();
+        if (session == nullptr) {
+            return;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        NodeStats& stats = session->profile()[node];
+        ++stats.backward_calls;
+        stats.backward_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        stats.max_abs_grad = std::fmax(stats.max_abs_grad, std::fabs(static_cast<double>(grad)));
+    }
+}
+
+}  // namespace grad::profiling
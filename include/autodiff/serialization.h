@@ -0,0 +1,484 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "autodiff/functions.h"
+#include "autodiff/half.h"
+#include "autodiff/node.h"
+#include "autodiff/ops.h"
+
+/**
+Binary graph format. A file is laid out as
+
+    Header | NodeRecord[node_count] | T[constant_count] | VariableRecord[variable_count] | names
+
+with every section 8-byte aligned. Nodes are in topological order (inputs always have a
+smaller index than their consumers) and the root is the last node, so a loader can run the
+nodes front to back straight out of an mmap'd file (see execution_plan.h) without building
+any Node<T> objects. Shared subexpressions are stored once.
+
+All integers are in host byte order; `endian_tag` lets a loader reject foreign files.
+*/
+namespace grad::serialization {
+
+inline constexpr std::array<char, 4> kMagic = {'A', 'D', 'G', 'F'};
+inline constexpr uint16_t kVersion = 1;
+inline constexpr uint32_t kEndianTag = 0x01020304;
+inline constexpr uint32_t kNoInput = UINT32_MAX;
+
+enum class ValueType : uint8_t {
+    UNKNOWN = 0,
+    FLOAT32,
+    FLOAT64,
+    FLOAT16,
+    BFLOAT16,
+};
+
+template <Numeric T>
+constexpr ValueType value_type_of() {
+    if constexpr (std::is_same_v<T, float>) {
+        return ValueType::FLOAT32;
+    } else if constexpr (std::is_same_v<T, double>) {
+        return ValueType::FLOAT64;
+    } else if constexpr (std::is_same_v<T, float16>) {
+        return ValueType::FLOAT16;
+    } else if constexpr (std::is_same_v<T, bfloat16>) {
+        return ValueType::BFLOAT16;
+    } else {
+        return ValueType::UNKNOWN;
+    }
+}
+
+struct Header {
+    std::array<char, 4> magic;
+    uint16_t version;
+    ValueType value_type;
+    uint8_t value_size;
+    uint32_t endian_tag;
+    uint32_t node_count;
+    uint32_t constant_count;
+    uint32_t variable_count;
+    uint32_t root;
+    uint32_t reserved;
+    uint64_t nodes_offset;
+    uint64_t constants_offset;
+    uint64_t variables_offset;
+    uint64_t strings_offset;
+    uint64_t total_size;
+    // FNV-1a over every byte after the header.
+    uint64_t payload_checksum;
+    // FNV-1a over the header with this field zeroed.
+    uint64_t header_checksum;
+};
+static_assert(sizeof(Header) == 88);
+
+/**
+One node. `payload` is the constant index for CONSTANT nodes and the variable index for
+VARIABLE nodes; unused otherwise.
+*/
+struct NodeRecord {
+    Op op;
+    uint8_t num_inputs;
+    uint16_t reserved;
+    std::array<uint32_t, 2> inputs;
+    uint32_t payload;
+};
+static_assert(sizeof(NodeRecord) == 16);
+
+struct VariableRecord {
+    uint32_t name_offset;
+    uint32_t name_length;
+};
+static_assert(sizeof(VariableRecord) == 8);
+
+inline uint64_t fnv1a(std::span<const std::byte> bytes, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (std::byte b : bytes) {
+        hash ^= static_cast<uint64_t>(b);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+inline uint64_t header_checksum(Header header) {
+    header.header_checksum = 0;
+    return fnv1a(std::as_bytes(std::span{&header, 1}));
+}
+
+namespace detail {
+
+inline size_t align8(size_t n) {
+    return (n + 7) & ~size_t{7};
+}
+
+// Post-order over the DAG, so every node comes after its inputs. Iterative so deep chains
+// don't overflow the stack.
+template <Numeric T>
+std::vector<const Node<T>*> topological_order(const ExpressionPtr<T>& root) {
+    std::vector<const Node<T>*> order;
+    std::unordered_set<const Node<T>*> visited;
+    std::vector<std::pair<const Node<T>*, size_t>> stack{{root.get(), 0}};
+    visited.insert(root.get());
+
+    while (!stack.empty()) {
+        auto& [node, next_input] = stack.back();
+        // Constants are leaves even if they still hold on to their (folded) inputs.
+        const bool is_leaf = node->get_op() == Op::CONSTANT || node->get_op() == Op::VARIABLE;
+        if (!is_leaf && next_input < node->get_inputs().size()) {
+            const Node<T>* input = node->get_inputs()[next_input++].get();
+            if (visited.insert(input).second) {
+                stack.emplace_back(input, 0);
+            }
+            continue;
+        }
+        order.push_back(node);
+        stack.pop_back();
+    }
+    return order;
+}
+
+}  // namespace detail
+
+/**
+Serializes the DAG rooted at `root`. Variables with the same name share one variable slot,
+matching how apply_variables binds them.
+*/
+template <Numeric T>
+std::vector<std::byte> serialize(const ExpressionPtr<T>& root) {
+    static_assert(value_type_of<T>() != ValueType::UNKNOWN, "No serialized value type for T");
+
+    const std::vector<const Node<T>*> order = detail::topological_order(root);
+
+    std::unordered_map<const Node<T>*, uint32_t> index;
+    index.reserve(order.size());
+
+    std::vector<NodeRecord> nodes;
+    nodes.reserve(order.size());
+    std::vector<T> constants;
+    std::vector<VariableRecord> variables;
+    std::unordered_map<std::string, uint32_t> variable_slots;
+    std::string names;
+
+    for (const Node<T>* node : order) {
+        NodeRecord record{
+            .op = node->get_op(), .num_inputs = 0, .reserved = 0, .inputs = {kNoInput, kNoInput}, .payload = 0};
+
+        if (node->get_op() == Op::VARIABLE) {
+            auto [it, inserted] = variable_slots.emplace(node->get_var_name(),
+                                                         static_cast<uint32_t>(variables.size()));
+            if (inserted) {
+                variables.push_back({static_cast<uint32_t>(names.size()),
+                                     static_cast<uint32_t>(node->get_var_name().size())});
+                names += node->get_var_name();
+            }
+            record.payload = it->second;
+        } else if (node->get_op() == Op::CONSTANT || node->get_inputs().empty()) {
+            record.op = Op::CONSTANT;
+            record.payload = static_cast<uint32_t>(constants.size());
+            constants.push_back(node->value());
+        } else {
+            record.num_inputs = static_cast<uint8_t>(node->get_inputs().size());
+            for (size_t i = 0; i < node->get_inputs().size(); ++i) {
+                record.inputs[i] = index.at(node->get_inputs()[i].get());
+            }
+        }
+
+        index.emplace(node, static_cast<uint32_t>(nodes.size()));
+        nodes.push_back(record);
+    }
+
+    Header header{};
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.value_type = value_type_of<T>();
+    header.value_size = sizeof(T);
+    header.endian_tag = kEndianTag;
+    header.node_count = static_cast<uint32_t>(nodes.size());
+    header.constant_count = static_cast<uint32_t>(constants.size());
+    header.variable_count = static_cast<uint32_t>(variables.size());
+    header.root = static_cast<uint32_t>(nodes.size() - 1);
+    header.nodes_offset = detail::align8(sizeof(Header));
+    header.constants_offset = detail::align8(header.nodes_offset + nodes.size() * sizeof(NodeRecord));
+    header.variables_offset = detail::align8(header.constants_offset + constants.size() * sizeof(T));
+    header.strings_offset =
+        detail::align8(header.variables_offset + variables.size() * sizeof(VariableRecord));
+    header.total_size = detail::align8(header.strings_offset + names.size());
+
+    std::vector<std::byte> bytes(header.total_size, std::byte{0});
+    std::memcpy(bytes.data() + header.nodes_offset, nodes.data(), nodes.size() * sizeof(NodeRecord));
+    std::memcpy(bytes.data() + header.constants_offset, constants.data(), constants.size() * sizeof(T));
+    std::memcpy(bytes.data() + header.variables_offset, variables.data(),
+                variables.size() * sizeof(VariableRecord));
+    std::memcpy(bytes.data() + header.strings_offset, names.data(), names.size());
+
+    header.payload_checksum = fnv1a(std::span{bytes}.subspan(sizeof(Header)));
+    header.header_checksum = header_checksum(header);
+    std::memcpy(bytes.data(), &header, sizeof(Header));
+    return bytes;
+}
+
+template <Numeric T>
+void save(const ExpressionPtr<T>& root, const std::string& path) {
+    const std::vector<std::byte> bytes = serialize(root);
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!out) {
+        throw std::runtime_error("Failed to write graph to " + path);
+    }
+}
+
+/**
+Non-owning, validated view over a serialized graph. The bytes must stay alive (and 8-byte
+aligned, which both std::vector<std::byte> storage and mmap give you) for as long as the
+view is used.
+*/
+template <Numeric T>
+class GraphView {
+   public:
+    GraphView() = default;
+
+    explicit GraphView(std::span<const std::byte> bytes, bool verify_checksum = true) : bytes_{bytes} {
+        if (bytes.size() < sizeof(Header)) {
+            throw std::runtime_error("Serialized graph is truncated");
+        }
+        std::memcpy(&header_, bytes.data(), sizeof(Header));
+
+        if (header_.magic != kMagic) {
+            throw std::runtime_error("Not a serialized autodiff graph");
+        }
+        if (header_.version != kVersion) {
+            throw std::runtime_error("Unsupported graph format version " + std::to_string(header_.version));
+        }
+        if (header_.endian_tag != kEndianTag) {
+            throw std::runtime_error("Serialized graph has foreign byte order");
+        }
+        if (header_checksum(header_) != header_.header_checksum) {
+            throw std::runtime_error("Serialized graph header checksum mismatch");
+        }
+        if (header_.value_type != value_type_of<T>() || header_.value_size != sizeof(T)) {
+            throw std::runtime_error("Serialized graph value type does not match");
+        }
+        if (reinterpret_cast<uintptr_t>(bytes.data()) % 8 != 0) {
+            throw std::runtime_error("Serialized graph is not 8-byte aligned in memory");
+        }
+        if (header_.total_size != bytes.size() || header_.node_count == 0 ||
+            header_.root != header_.node_count - 1 || header_.nodes_offset < sizeof(Header) ||
+            !section_fits(header_.nodes_offset, header_.node_count, sizeof(NodeRecord), header_.constants_offset) ||
+            !section_fits(header_.constants_offset, header_.constant_count, sizeof(T), header_.variables_offset) ||
+            !section_fits(header_.variables_offset, header_.variable_count, sizeof(VariableRecord),
+                          header_.strings_offset) ||
+            !section_fits(header_.strings_offset, 0, 1, header_.total_size)) {
+            throw std::runtime_error("Serialized graph has an invalid layout");
+        }
+        if (verify_checksum && fnv1a(bytes.subspan(sizeof(Header))) != header_.payload_checksum) {
+            throw std::runtime_error("Serialized graph payload checksum mismatch");
+        }
+
+        nodes_ = reinterpret_cast<const NodeRecord*>(bytes.data() + header_.nodes_offset);
+        constants_ = reinterpret_cast<const T*>(bytes.data() + header_.constants_offset);
+        variables_ = reinterpret_cast<const VariableRecord*>(bytes.data() + header_.variables_offset);
+        names_ = reinterpret_cast<const char*>(bytes.data() + header_.strings_offset);
+        validate_nodes();
+    }
+
+    const Header& header() const { return header_; }
+
+    size_t node_count() const { return header_.node_count; }
+    size_t variable_count() const { return header_.variable_count; }
+    uint32_t root() const { return header_.root; }
+
+    const NodeRecord& node(size_t i) const { return nodes_[i]; }
+    std::span<const NodeRecord> nodes() const { return {nodes_, node_count()}; }
+    T constant(size_t i) const { return constants_[i]; }
+
+    std::string_view variable_name(size_t i) const {
+        return {names_ + variables_[i].name_offset, variables_[i].name_length};
+    }
+
+    // Same format as Node<T>::to_string.
+    std::string to_string() const { return to_string(root()); }
+
+    std::string to_string(uint32_t i) const {
+        const NodeRecord& record = nodes_[i];
+        if (record.op == Op::VARIABLE) {
+            return "Var(" + std::string{variable_name(record.payload)} + ")";
+        } else if (record.op == Op::CONSTANT) {
+            return "Const(" + std::to_string(math::widen(constant(record.payload))) + ")";
+        } else if (is_unary_op(record.op)) {
+            return op_to_string(record.op) + "(" + to_string(record.inputs[0]) + ")";
+        } else {
+            return op_to_string(record.op) + "(" + to_string(record.inputs[0]) + ", " +
+                   to_string(record.inputs[1]) + ")";
+        }
+    }
+
+   private:
+    // Whether `count` records starting at `offset` end by `limit`, with the section 8-byte
+    // aligned. Written with a division so a crafted header can't wrap the sum around.
+    static bool section_fits(uint64_t offset, uint64_t count, uint64_t record_size, uint64_t limit) {
+        return offset % 8 == 0 && offset <= limit && count <= (limit - offset) / record_size;
+    }
+
+    void validate_nodes() const {
+        const uint64_t names_size = header_.total_size - header_.strings_offset;
+        for (uint32_t i = 0; i < header_.variable_count; ++i) {
+            if (uint64_t{variables_[i].name_offset} + variables_[i].name_length > names_size) {
+                throw std::runtime_error("Serialized graph has an invalid variable name");
+            }
+        }
+
+        for (uint32_t i = 0; i < header_.node_count; ++i) {
+            const NodeRecord& record = nodes_[i];
+            if (record.op == Op::CONSTANT) {
+                if (record.num_inputs != 0 || record.payload >= header_.constant_count) {
+                    throw std::runtime_error("Serialized graph has an invalid constant node");
+                }
+                continue;
+            }
+            if (record.op == Op::VARIABLE) {
+                if (record.num_inputs != 0 || record.payload >= header_.variable_count) {
+                    throw std::runtime_error("Serialized graph has an invalid variable node");
+                }
+                continue;
+            }
+
+            const uint8_t expected_inputs = is_unary_op(record.op) ? 1 : is_binary_op(record.op) ? 2 : 0;
+            if (expected_inputs == 0 || record.num_inputs != expected_inputs) {
+                throw std::runtime_error("Serialized graph has an invalid op at node " + std::to_string(i));
+            }
+            for (uint8_t j = 0; j < record.num_inputs; ++j) {
+                // Inputs must come first, which also rules out cycles.
+                if (record.inputs[j] >= i) {
+                    throw std::runtime_error("Serialized graph is not topologically ordered");
+                }
+            }
+        }
+    }
+
+    std::span<const std::byte> bytes_{};
+    Header header_{};
+    const NodeRecord* nodes_{nullptr};
+    const T* constants_{nullptr};
+    const VariableRecord* variables_{nullptr};
+    const char* names_{nullptr};
+};
+
+/**
+Read-only mmap of a whole file. Move-only; unmaps on destruction.
+*/
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open " + path);
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Could not stat " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            throw std::runtime_error("Could not mmap " + path);
+        }
+    }
+
+    MappedFile(MappedFile&& other) noexcept
+        : data_{std::exchange(other.data_, nullptr)}, size_{std::exchange(other.size_, 0)} {}
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() { unmap(); }
+
+    std::span<const std::byte> bytes() const { return {static_cast<const std::byte*>(data_), size_}; }
+
+   private:
+    void unmap() {
+        if (data_ != nullptr) {
+            ::munmap(data_, size_);
+        }
+    }
+
+    void* data_{nullptr};
+    size_t size_{0};
+};
+
+/**
+A serialized graph mapped straight from disk. Nothing is copied; pages are faulted in as
+the graph is read.
+*/
+template <Numeric T>
+class MappedGraph {
+   public:
+    explicit MappedGraph(const std::string& path, bool verify_checksum = true)
+        : file_{path}, view_{file_.bytes(), verify_checksum} {}
+
+    const GraphView<T>& view() const { return view_; }
+
+   private:
+    MappedFile file_;
+    GraphView<T> view_;
+};
+
+/**
+Rebuilds a Node<T> graph (with backprop closures) from a serialized one. Variable nodes
+sharing a name are recreated as a single node.
+*/
+template <Numeric T>
+ExpressionPtr<T> to_expression(const GraphView<T>& view) {
+    std::vector<ExpressionPtr<T>> built(view.node_count());
+    std::vector<ExpressionPtr<T>> variables(view.variable_count());
+
+    for (uint32_t i = 0; i < view.node_count(); ++i) {
+        const NodeRecord& record = view.node(i);
+        if (record.op == Op::CONSTANT) {
+            built[i] = constant(view.constant(record.payload));
+        } else if (record.op == Op::VARIABLE) {
+            if (!variables[record.payload]) {
+                variables[record.payload] = variable<T>(std::string{view.variable_name(record.payload)});
+            }
+            built[i] = variables[record.payload];
+        } else {
+            typename Node<T>::SubexprContainerT inputs;
+            for (uint8_t j = 0; j < record.num_inputs; ++j) {
+                inputs.push_back(built[record.inputs[j]]);
+            }
+            built[i] = apply_op<T>(record.op, inputs);
+        }
+    }
+    return built[view.root()];
+}
+
+}  // namespace grad::serialization
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cmath>
+#include <concepts>
+#include <limits>
+
+#include "autodiff/train/parameters.h"
+
+namespace grad::train {
+
+/**
+Dynamic loss scaling for reduced precision graphs. Backprop carries adjoints in the
+accumulator type, but wherever gradients are read back as T (Node::grad(),
+ExecutionPlan::variable_grad(), pipeline outputs) small ones underflow to zero in float16
+(anything below ~6e-8). So the backward pass is seeded with `scale` instead of 1, which
+shifts every node's gradient up by the same factor; the buffer's grads are divided by it
+again in the wider Scalar type before the optimizer sees them.
+
+If a scaled gradient overflows T, the step is skipped and the scale backs off. After
+growth_interval finite steps in a row the scale grows again, so it tracks the largest value
+the gradients tolerate. The scale never grows past the largest power of two T can hold,
+since the seed itself has to be representable and a power of two unscales exactly.
+
+    LossScaler<float16> scaler;
+    root->evaluate();
+    scaler.backward(root);
+    params.gather_grads();
+    scaler.step(optimizer, params);  // unscale, skip on inf/nan, update the scale
+*/
+template <std::floating_point S>
+struct LossScalerOptions {
+    S initial_scale{S(32768)};
+    S growth_factor{S(2)};
+    S backoff_factor{S(0.5)};
+    size_t growth_interval{2000};
+};
+
+template <Trainable T>
+class LossScaler {
+   public:
+    using Scalar = accumulator_t<T>;
+
+    explicit LossScaler(LossScalerOptions<Scalar> options = {})
+        : options_{options}, scale_{std::fmin(options.initial_scale, max_scale())} {}
+
+    // Seed for backward passes that aren't driven by Node, e.g. ExecutionPlan::backward(seed).
+    T seed() const { return static_cast<T>(scale_); }
+
+    void backward(const ExpressionPtr<T>& loss) const { loss->get_gradients(seed()); }
+
+    // Divides the gathered grads by the scale. Returns false if any of them is inf or nan, in
+    // which case the grads are left as they are and the step should be skipped.
+    bool unscale(ParameterBuffer<T>& params) const {
+        Scalar* grads = params.grads().data();
+        // The sum is only finite if every element is, so one check covers the whole buffer.
+        Scalar sum{0};
+        for (size_t i = 0; i < params.size(); ++i) sum += grads[i] * Scalar{0};
+        if (!std::isfinite(sum)) {
+            return false;
+        }
+        const Scalar inverse = Scalar{1} / scale_;
+        for (size_t i = 0; i < params.size(); ++i) grads[i] *= inverse;
+        return true;
+    }
+
+    // Backs off after an overflowing step, grows after growth_interval finite ones.
+    void update(bool finite) {
+        if (!finite) {
+            scale_ *= options_.backoff_factor;
+            good_steps_ = 0;
+            return;
+        }
+        if (++good_steps_ >= options_.growth_interval) {
+            scale_ = std::fmin(scale_ * options_.growth_factor, max_scale());
+            good_steps_ = 0;
+        }
+    }
+
+    // unscale + optimizer step + update. Returns whether the step was taken.
+    template <typename Optimizer>
+    bool step(Optimizer& optimizer, ParameterBuffer<T>& params) {
+        const bool finite = unscale(params);
+        if (finite) {
+            optimizer.step(params);
+        }
+        update(finite);
+        return finite;
+    }
+
+    Scalar scale() const { return scale_; }
+    size_t good_steps() const { return good_steps_; }
+    LossScalerOptions<Scalar>& options() { return options_; }
+
+   private:
+    static Scalar max_scale() {
+        return std::exp2(std::floor(std::log2(math::widen(std::numeric_limits<T>::max()))));
+    }
+
+    LossScalerOptions<Scalar> options_;
+    Scalar scale_;
+    size_t good_steps_{0};
+};
+
+}  // namespace grad::train
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "autodiff/train/parameters.h"
+
+namespace grad::train {
+
+/**
+Optimizers that update a ParameterBuffer in place. Each step is one fused loop over the
+value/grad buffers (plus the optimizer's own state buffers): averaging over accumulated
+minibatches, clipping, weight decay and the update itself are applied per element in the
+same pass, and the new values are then written back to the graph's nodes.
+
+Gradient clipping is off unless a limit is set. max_norm rescales the whole (averaged)
+gradient vector when its L2 norm exceeds the limit, which costs one extra read pass;
+max_value clamps each element.
+
+Options and optimizer state are in the buffer's Scalar type (accumulator_t<T>), e.g. an
+SGD<float16> takes SGDOptions<float>.
+*/
+template <std::floating_point T>
+struct GradientClipping {
+    T max_norm{0};
+    T max_value{0};
+};
+
+template <std::floating_point T>
+struct SGDOptions {
+    T learning_rate{T(0.01)};
+    T weight_decay{0};
+    GradientClipping<T> clipping{};
+};
+
+template <std::floating_point T>
+struct MomentumOptions {
+    T learning_rate{T(0.01)};
+    T momentum{T(0.9)};
+    bool nesterov{false};
+    T weight_decay{0};
+    GradientClipping<T> clipping{};
+};
+
+// weight_decay is decoupled from the gradient (AdamW).
+template <std::floating_point T>
+struct AdamOptions {
+    T learning_rate{T(0.001)};
+    T beta1{T(0.9)};
+    T beta2{T(0.999)};
+    T epsilon{T(1e-8)};
+    T weight_decay{0};
+    GradientClipping<T> clipping{};
+};
+
+namespace detail {
+
+// Per-element transform from the raw gathered grad to the one the update should use.
+template <std::floating_point T>
+struct GradTransform {
+    T scale;
+    T limit;
+
+    T operator()(T g) const { return std::clamp(g * scale, -limit, limit); }
+};
+
+template <Trainable T, typename S = accumulator_t<T>>
+GradTransform<S> grad_transform(const ParameterBuffer<T>& params, const GradientClipping<S>& clipping) {
+    S scale = params.accumulated() > 1 ? S{1} / static_cast<S>(params.accumulated()) : S{1};
+    if (clipping.max_norm > 0) {
+        const S norm = params.grad_norm() * scale;
+        if (norm > clipping.max_norm) {
+            scale *= clipping.max_norm / norm;
+        }
+    }
+    const S limit = clipping.max_value > 0 ? clipping.max_value : std::numeric_limits<S>::infinity();
+    return {scale, limit};
+}
+
+template <std::floating_point T>
+void resize_state(std::vector<T>& state, size_t size) {
+    if (state.size() != size) {
+        state.assign(size, T{0});
+    }
+}
+
+}  // namespace detail
+
+/**************************************
+                 SGD
+***************************************/
+template <Trainable T>
+class SGD {
+   public:
+    using Scalar = accumulator_t<T>;
+
+    explicit SGD(SGDOptions<Scalar> options = {}) : options_{options} {}
+
+    void step(ParameterBuffer<T>& params) {
+        const detail::GradTransform<Scalar> transform = detail::grad_transform(params, options_.clipping);
+        Scalar* values = params.values().data();
+        const Scalar* grads = params.grads().data();
+        const Scalar lr = options_.learning_rate;
+        const Scalar decay = options_.weight_decay;
+        for (size_t i = 0; i < params.size(); ++i) {
+            const Scalar g = transform(grads[i]) + decay * values[i];
+            values[i] -= lr * g;
+        }
+        params.scatter_values();
+    }
+
+    SGDOptions<Scalar>& options() { return options_; }
+
+   private:
+    SGDOptions<Scalar> options_;
+};
+
+/**************************************
+               Momentum
+***************************************/
+template <Trainable T>
+class Momentum {
+   public:
+    using Scalar = accumulator_t<T>;
+
+    explicit Momentum(MomentumOptions<Scalar> options = {}) : options_{options} {}
+
+    void step(ParameterBuffer<T>& params) {
+        detail::resize_state(velocity_, params.size());
+        const detail::GradTransform<Scalar> transform = detail::grad_transform(params, options_.clipping);
+        Scalar* values = params.values().data();
+        const Scalar* grads = params.grads().data();
+        Scalar* velocity = velocity_.data();
+        const Scalar lr = options_.learning_rate;
+        const Scalar mu = options_.momentum;
+        const Scalar decay = options_.weight_decay;
+        // Branch hoisted out of the element loops.
+        if (options_.nesterov) {
+            for (size_t i = 0; i < params.size(); ++i) {
+                const Scalar g = transform(grads[i]) + decay * values[i];
+                velocity[i] = mu * velocity[i] + g;
+                values[i] -= lr * (g + mu * velocity[i]);
+            }
+        } else {
+            for (size_t i = 0; i < params.size(); ++i) {
+                const Scalar g = transform(grads[i]) + decay * values[i];
+                velocity[i] = mu * velocity[i] + g;
+                values[i] -= lr * velocity[i];
+            }
+        }
+        params.scatter_values();
+    }
+
+    MomentumOptions<Scalar>& options() { return options_; }
+    std::span<const Scalar> velocity() const { return velocity_; }
+
+   private:
+    MomentumOptions<Scalar> options_;
+    std::vector<Scalar> velocity_;
+};
+
+/**************************************
+                 Adam
+***************************************/
+template <Trainable T>
+class Adam {
+   public:
+    using Scalar = accumulator_t<T>;
+
+    explicit Adam(AdamOptions<Scalar> options = {}) : options_{options} {}
+
+    void step(ParameterBuffer<T>& params) {
+        detail::resize_state(first_moment_, params.size());
+        detail::resize_state(second_moment_, params.size());
+        ++steps_;
+
+        const detail::GradTransform<Scalar> transform = detail::grad_transform(params, options_.clipping);
+        Scalar* values = params.values().data();
+        const Scalar* grads = params.grads().data();
+        Scalar* m = first_moment_.data();
+        Scalar* v = second_moment_.data();
+        const Scalar beta1 = options_.beta1;
+        const Scalar beta2 = options_.beta2;
+        const Scalar epsilon = options_.epsilon;
+        const Scalar decay = options_.learning_rate * options_.weight_decay;
+        // Bias corrections folded into the step size and epsilon, so the loop has no pow.
+        const Scalar correction1 = 1 - std::pow(beta1, static_cast<Scalar>(steps_));
+        const Scalar correction2 = std::sqrt(1 - std::pow(beta2, static_cast<Scalar>(steps_)));
+        const Scalar step_size = options_.learning_rate * correction2 / correction1;
+        const Scalar scaled_epsilon = epsilon * correction2;
+        for (size_t i = 0; i < params.size(); ++i) {
+            const Scalar g = transform(grads[i]);
+            m[i] = beta1 * m[i] + (1 - beta1) * g;
+            v[i] = beta2 * v[i] + (1 - beta2) * g * g;
+            values[i] -= step_size * m[i] / (std::sqrt(v[i]) + scaled_epsilon) + decay * values[i];
+        }
+        params.scatter_values();
+    }
+
+    AdamOptions<Scalar>& options() { return options_; }
+    size_t steps() const { return steps_; }
+
+   private:
+    AdamOptions<Scalar> options_;
+    std::vector<Scalar> first_moment_;
+    std::vector<Scalar> second_moment_;
+    size_t steps_{0};
+};
+
+}  // namespace grad::train
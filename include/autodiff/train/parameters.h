@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "autodiff/node.h"
+
+namespace grad::train {
+
+// How ParameterBuffer::gather_grads combines node grads with the buffer.
+enum class Gather {
+    OVERWRITE,
+    ACCUMULATE,
+};
+
+// Types ParameterBuffer and the optimizers can train: any Numeric T whose accumulator is a
+// floating point type, so float16/bfloat16 graphs get float master weights.
+template <typename T>
+concept Trainable = Numeric<T> && std::floating_point<accumulator_t<T>>;
+
+/**
+Contiguous storage for the trainable leaves of a graph. Parameters are registered once;
+after that their values and gradients live in two flat arrays indexed by registration
+order, so optimizer steps are plain loops over memory instead of a pointer chase through
+ExpressionPtrs per update.
+
+A training step is:
+
+    root->evaluate();
+    root->get_gradients();
+    params.gather_grads();      // node grads -> grads()
+    optimizer.step(params);     // updates values() and writes them back to the nodes
+
+To accumulate gradients over several minibatches, call zero_grads(), then
+gather_grads(Gather::ACCUMULATE) after each backward pass, and step once; the optimizer
+averages over the number of accumulated passes.
+
+Only registration allocates (and each optimizer sizes its state on its first step);
+gathers, scatters and steady-state steps never do.
+
+The buffers hold accumulator_t<T> (Scalar), so for reduced precision graphs they are the
+full precision master copy of the weights: nodes only ever see values rounded to T, while
+updates smaller than T's resolution still add up in values().
+*/
+template <Trainable T>
+class ParameterBuffer {
+   public:
+    using Scalar = accumulator_t<T>;
+
+    ParameterBuffer() = default;
+    explicit ParameterBuffer(const std::vector<ExpressionPtr<T>>& parameters) { add(parameters); }
+
+    /**************************************
+                 Registration
+    ***************************************/
+    // Returns the parameter's index in values()/grads().
+    size_t add(const ExpressionPtr<T>& parameter) {
+        if (parameter->get_op() != Op::CONSTANT || !parameter->get_inputs().empty()) {
+            throw std::runtime_error("Only leaf constants can be trained, got " + parameter->to_string());
+        }
+        if (!indices_.emplace(parameter.get(), nodes_.size()).second) {
+            throw std::runtime_error("Parameter " + parameter->to_string() + " is already registered");
+        }
+        owners_.push_back(parameter);
+        nodes_.push_back(parameter.get());
+        values_.push_back(math::widen(parameter->value()));
+        grads_.push_back(Scalar{0});
+        return nodes_.size() - 1;
+    }
+
+    void add(const std::vector<ExpressionPtr<T>>& parameters) {
+        for (const auto& parameter : parameters) {
+            add(parameter);
+        }
+    }
+
+    /**************************************
+              Node <-> buffer copies
+    ***************************************/
+    // Reads every parameter's adjoint from its node, after Node::get_gradients().
+    void gather_grads(Gather mode = Gather::OVERWRITE) {
+        if (mode == Gather::OVERWRITE) {
+            for (size_t i = 0; i < nodes_.size(); ++i) grads_[i] = nodes_[i]->wide_grad();
+            accumulated_ = 1;
+        } else {
+            for (size_t i = 0; i < nodes_.size(); ++i) grads_[i] += nodes_[i]->wide_grad();
+            ++accumulated_;
+        }
+    }
+
+    // Writes values() back into the nodes; optimizers call this at the end of a step.
+    void scatter_values() {
+        for (size_t i = 0; i < nodes_.size(); ++i) nodes_[i]->set_value(static_cast<T>(values_[i]));
+    }
+
+    // Re-reads the values from the nodes, e.g. after changing a parameter through its node.
+    void gather_values() {
+        for (size_t i = 0; i < nodes_.size(); ++i) values_[i] = math::widen(nodes_[i]->value());
+    }
+
+    void zero_grads() {
+        std::fill(grads_.begin(), grads_.end(), Scalar{0});
+        accumulated_ = 0;
+    }
+
+    /**************************************
+            Getters and setters
+    ***************************************/
+    size_t size() const { return nodes_.size(); }
+    // The registered nodes, in registration order.
+    const std::vector<ExpressionPtr<T>>& parameters() const { return owners_; }
+    std::span<Scalar> values() { return values_; }
+    std::span<const Scalar> values() const { return values_; }
+    std::span<Scalar> grads() { return grads_; }
+    std::span<const Scalar> grads() const { return grads_; }
+    const ExpressionPtr<T>& parameter(size_t i) const { return owners_[i]; }
+
+    size_t index_of(const ExpressionPtr<T>& parameter) const {
+        auto it = indices_.find(parameter.get());
+        if (it == indices_.end()) {
+            throw std::runtime_error("Parameter " + parameter->to_string() + " is not registered");
+        }
+        return it->second;
+    }
+
+    // Backward passes summed into grads() since the last overwrite/zero_grads().
+    size_t accumulated() const { return accumulated_; }
+
+    Scalar grad_norm() const {
+        Scalar sum{0};
+        for (Scalar g : grads_) sum += g * g;
+        return std::sqrt(sum);
+    }
+
+   private:
+    std::vector<ExpressionPtr<T>> owners_;
+    std::vector<Node<T>*> nodes_;
+    std::unordered_map<const Node<T>*, size_t> indices_;
+    std::vector<Scalar> values_;
+    std::vector<Scalar> grads_;
+    size_t accumulated_{0};
+};
+
+}  // namespace grad::train
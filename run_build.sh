@@ -1,15 +1,28 @@
 #!/bin/bash
 
 SKIP_TESTS=0
-while getopts "s" opt; do
+RUN_BENCHMARKS=0
+while getopts "sb" opt; do
     case $opt in
         s) SKIP_TESTS=1 ;;
-        *) echo "Usage: $0 [-s] (s flag skips tests)" && exit 1 ;;
+        b) RUN_BENCHMARKS=1 ;;
+        *) echo "Usage: $0 [-s] [-b] (s flag skips tests, b flag runs benchmarks)" && exit 1 ;;
     esac
 done
 
 cwd=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
 
+# Benchmarks get their own optimized, non-ASAN build directory so the numbers are comparable
+# between runs. Results are written as JSON to build-bench/benchmarks.json.
+if [ $RUN_BENCHMARKS -eq 1 ]; then
+    bench_directory="${cwd}/build-bench/"
+    mkdir -p "${bench_directory}"
+    cd "${bench_directory}"
+    cmake -DCMAKE_BUILD_TYPE=Release -DENABLE_ASAN=OFF -DBUILD_BENCHMARKS=ON -Wno-dev ..
+    cmake --build . --target run_benchmarks
+    exit $?
+fi
+
 # Set up cmake build directory if it isn't already setup
 build_directory="${cwd}/build/"
 
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <cmath>
 #include <numbers>
 
 #include "autodiff/functions.h"
@@ -53,3 +54,17 @@ TEST(AutodiffTest, VariableGradientTestTrig) {
     EXPECT_NEAR(x->grad(), -0.1767766953f, 0.0001f);
     EXPECT_NEAR(y->grad(), -2.22144146908f, 0.0001f);
 }
+
+// `a` feeds the root directly and through sin(sin(a)). Backprop has to wait for both paths to
+// finish accumulating into a before passing its gradient on to x; a BFS order visits a
+// (depth 1) before sin(a) (depth 2) and dropped the long path's contribution.
+TEST(AutodiffTest, SharedNodeWaitsForAllConsumers) {
+    auto x = grad::constant(0.5);
+    auto a = grad::exp(x);
+    auto root = a + grad::sin(grad::sin(a));
+    root->get_gradients();
+
+    const double ea = std::exp(0.5);
+    EXPECT_NEAR(a->grad(), 1 + std::cos(std::sin(ea)) * std::cos(ea), 1e-12);
+    EXPECT_NEAR(x->grad(), ea * (1 + std::cos(std::sin(ea)) * std::cos(ea)), 1e-12);
+}
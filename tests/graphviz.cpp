@@ -0,0 +1,80 @@
+#define AUTODIFF_ENABLE_PROFILING
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "autodiff/functions.h"
+#include "autodiff/graphviz.h"
+#include "autodiff/profiling.h"
+
+namespace {
+
+size_t count_occurrences(const std::string& haystack, const std::string& needle) {
+    size_t count = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string::npos;
+         pos = haystack.find(needle, pos + needle.size())) {
+        ++count;
+    }
+    return count;
+}
+
+}  // namespace
+
+TEST(GraphvizTest, SharedNodesAreEmittedOnce) {
+    auto x = grad::constant(2.f);
+    auto shared = x * x;
+    auto expr = grad::sin(shared) + shared;
+
+    std::string dot = grad::to_dot(expr);
+
+    // x, shared, sin, add
+    EXPECT_EQ(count_occurrences(dot, "[label="), 4u);
+    // x -> shared (twice), shared -> sin, shared -> add, sin -> add
+    EXPECT_EQ(count_occurrences(dot, " -> "), 5u);
+    EXPECT_EQ(count_occurrences(dot, "Const(2)"), 1u);
+    EXPECT_EQ(dot.rfind("digraph autodiff {", 0), 0u);
+}
+
+TEST(GraphvizTest, VariablesAreLabelledByName) {
+    auto expr = grad::variable<float>("weight") * grad::constant(3.f);
+    std::string dot = grad::to_dot(expr);
+    EXPECT_NE(dot.find("Var(weight)"), std::string::npos);
+    EXPECT_NE(dot.find("MUL"), std::string::npos);
+}
+
+TEST(GraphvizTest, ProfilingCollectsForwardAndBackwardStats) {
+    auto x = grad::constant(0.5f);
+    auto y = grad::constant(-4.f);
+    auto mul = x * y;
+    auto expr = grad::tanh(mul);
+
+    grad::profiling::Session session;
+    expr->evaluate();
+    expr->evaluate();
+    expr->get_gradients();
+
+    const grad::profiling::Profile& profile = session.profile();
+    ASSERT_TRUE(profile.contains(mul.get()));
+    const grad::profiling::NodeStats& stats = profile.at(mul.get());
+    EXPECT_EQ(stats.forward_calls, 2u);
+    EXPECT_EQ(stats.backward_calls, 1u);
+    EXPECT_FLOAT_EQ(stats.max_abs_value, 2.f);
+    EXPECT_NEAR(stats.max_abs_grad, 1 - std::pow(std::tanh(2.f), 2), 1e-6);
+
+    ASSERT_TRUE(profile.contains(y.get()));
+    EXPECT_FLOAT_EQ(profile.at(y.get()).max_abs_value, 4.f);
+
+    std::string dot = grad::to_dot(expr, &profile);
+    EXPECT_NE(dot.find("calls fwd=2 bwd=1"), std::string::npos);
+    EXPECT_NE(dot.find("fillcolor=\"0.000 "), std::string::npos);
+}
+
+TEST(GraphvizTest, NothingIsRecordedWithoutASession) {
+    auto expr = grad::constant(1.f) + grad::constant(2.f);
+    expr->evaluate();
+
+    grad::profiling::Session session;
+    EXPECT_TRUE(session.profile().empty());
+    EXPECT_EQ(grad::to_dot(expr, &session.profile()).find("calls"), std::string::npos);
+}
@@ -0,0 +1,349 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "autodiff/execution_plan.h"
+#include "autodiff/functions.h"
+#include "autodiff/half.h"
+#include "autodiff/serialization.h"
+#include "autodiff/train/loss_scaler.h"
+#include "autodiff/train/optimizers.h"
+
+namespace {
+
+using namespace grad;
+using namespace grad::train;
+
+template <typename T>
+class ReducedPrecisionTest : public ::testing::Test {};
+
+using ReducedPrecisionTypes = ::testing::Types<float16, bfloat16>;
+
+// Error allowed relative to the double graph: a handful of ULPs (epsilon is 2^-10 for float16,
+// 2^-7 for bfloat16) through a few chained ops.
+template <typename T>
+double tolerance() {
+    return std::is_same_v<T, float16> ? 1e-2 : 5e-2;
+}
+
+template <typename T>
+void expect_close(T got, double want, const char* what) {
+    EXPECT_NEAR(static_cast<double>(got), want, tolerance<T>() * std::fmax(1.0, std::fabs(want))) << what;
+}
+
+// sin, exp, tanh and ln mixed through adds, muls and a divide.
+template <typename T>
+struct Model {
+    ExpressionPtr<T> x;
+    ExpressionPtr<T> y;
+    ExpressionPtr<T> root;
+
+    Model(double x_value, double y_value) : x{constant(T{x_value})}, y{constant(T{y_value})} {
+        root = grad::sin(x) * grad::exp(y) + grad::tanh(x * y) + grad::ln(x + y) * x + x / (y + T{2});
+    }
+};
+
+// Four layers of h = exp(tanh(h * x) * y) * y: every adjoint passes through a dozen hops.
+template <typename T>
+ExpressionPtr<T> layered_chain(const ExpressionPtr<T>& x, const ExpressionPtr<T>& y) {
+    ExpressionPtr<T> h = x;
+    for (int layer = 0; layer < 4; ++layer) {
+        h = grad::exp(grad::tanh(h * x) * y) * y;
+    }
+    return h;
+}
+
+}  // namespace
+
+TYPED_TEST_SUITE(ReducedPrecisionTest, ReducedPrecisionTypes);
+
+/**************************************
+             Conversions
+***************************************/
+TYPED_TEST(ReducedPrecisionTest, EveryBitPatternRoundTrips) {
+    using T = TypeParam;
+    for (uint32_t bits = 0; bits <= 0xffff; ++bits) {
+        const T value = T::from_bits(static_cast<uint16_t>(bits));
+        const float wide = static_cast<float>(value);
+        const T back{wide};
+        if (std::isnan(wide)) {
+            EXPECT_TRUE(std::isnan(static_cast<float>(back))) << std::hex << bits;
+        } else {
+            EXPECT_EQ(back.bits, bits) << std::hex << bits;
+        }
+    }
+}
+
+// Midpoints between neighbouring values are exact in float: they must round to the even
+// neighbour, and anything off the midpoint to the nearer one.
+TYPED_TEST(ReducedPrecisionTest, RoundsToNearestEven) {
+    using T = TypeParam;
+    const uint16_t max_bits = std::numeric_limits<T>::max().bits;
+    for (uint16_t bits = 0; bits < max_bits; ++bits) {
+        const float lo = static_cast<float>(T::from_bits(bits));
+        const float hi = static_cast<float>(T::from_bits(bits + 1));
+        const float mid = lo + (hi - lo) / 2;
+        const uint16_t even = (bits & 1) == 0 ? bits : bits + 1;
+        ASSERT_EQ(T{mid}.bits, even) << std::hex << bits;
+        ASSERT_EQ(T{std::nextafter(mid, 0.f)}.bits, bits) << std::hex << bits;
+        ASSERT_EQ(T{std::nextafter(mid, hi)}.bits, bits + 1) << std::hex << bits;
+        ASSERT_EQ(T{-mid}.bits, even | 0x8000) << std::hex << bits;
+    }
+}
+
+TEST(Float16Test, OverflowAndSubnormalEdges) {
+    EXPECT_EQ(float16{65504.f}.bits, 0x7bff);
+    EXPECT_EQ(float16{65519.f}.bits, 0x7bff);
+    EXPECT_EQ(float16{65520.f}.bits, 0x7c00);
+    EXPECT_EQ(float16{-1e9f}.bits, 0xfc00);
+    EXPECT_EQ(float16{std::numeric_limits<float>::infinity()}.bits, 0x7c00);
+    EXPECT_TRUE(std::isnan(static_cast<float>(float16{std::numeric_limits<float>::quiet_NaN()})));
+
+    const float denorm_min = std::ldexp(1.f, -24);
+    EXPECT_EQ(float16{denorm_min}.bits, 0x0001);
+    EXPECT_EQ(float16{denorm_min / 2}.bits, 0x0000);          // tie, rounds to even zero
+    EXPECT_EQ(float16{denorm_min * 0.75f}.bits, 0x0001);
+    EXPECT_EQ(float16{denorm_min * 1.5f}.bits, 0x0002);       // tie, rounds to even 2
+    EXPECT_EQ(float16{std::ldexp(1.f, -14)}.bits, 0x0400);    // smallest normal
+    EXPECT_EQ(float16{std::ldexp(1023.5f, -24)}.bits, 0x0400);  // tie past the largest subnormal
+}
+
+TEST(Float16Test, ArithmeticRoundsEachOperation) {
+    const float16 one{1};
+    const float16 half_ulp{std::ldexp(1.f, -11)};
+    EXPECT_EQ(one + half_ulp, one);  // 1 + 2^-11 is a tie, rounds back to 1
+    EXPECT_EQ(static_cast<float>(one + half_ulp + half_ulp), 1.f);
+    EXPECT_EQ(static_cast<float>(one + (half_ulp + half_ulp)), 1.f + std::ldexp(1.f, -10));
+    EXPECT_EQ((-one).bits, 0xbc00);
+    EXPECT_TRUE(float16{2} > one);
+    EXPECT_EQ(static_cast<float>(float16{3} / float16{4}), 0.75f);
+}
+
+/**************************************
+        Graphs vs the double graph
+***************************************/
+TYPED_TEST(ReducedPrecisionTest, GraphMatchesDoubleGraph) {
+    using T = TypeParam;
+    for (auto [xv, yv] : std::vector<std::pair<double, double>>{{0.5, 0.25}, {1.5, -0.75}, {2.0, 1.0}, {0.1, 3.0}}) {
+        // The double graph gets the same rounded inputs, so only the arithmetic differs.
+        Model<double> reference{static_cast<double>(T{xv}), static_cast<double>(T{yv})};
+        Model<T> model{xv, yv};
+        reference.root->evaluate();
+        reference.root->get_gradients();
+        model.root->evaluate();
+        model.root->get_gradients();
+
+        expect_close(model.root->value(), reference.root->value(), "value");
+        expect_close(model.x->grad(), reference.x->grad(), "d/dx");
+        expect_close(model.y->grad(), reference.y->grad(), "d/dy");
+    }
+}
+
+// Each add node hands x a gradient of 1. Summed in T the adjoint would stall at 2048 (where
+// float16's spacing becomes 2); Node accumulates in the wider type instead.
+TEST(Float16Test, GradientsAccumulateInTheWiderType) {
+    auto x = constant(float16{1});
+    ExpressionPtr<float16> sum = x;
+    for (int i = 1; i < 3000; ++i) sum = sum + x;
+    sum->evaluate();
+    sum->get_gradients();
+    EXPECT_EQ(static_cast<float>(sum->value()), 2048.f);  // the forward values are stored in T
+    EXPECT_EQ(static_cast<float>(x->grad()), 3000.f);
+}
+
+// Same fan-in through the execution plans: their adjoints are in the wider type too, so both
+// executors agree with Node.
+TEST(Float16Test, PlansAccumulateGradientsInTheWiderType) {
+    auto x = variable<float16>("x");
+    ExpressionPtr<float16> sum = x;
+    for (int i = 1; i < 3000; ++i) sum = sum + x;
+    const std::vector<std::byte> bytes = serialization::serialize(sum);
+    const serialization::GraphView<float16> view{bytes};
+
+    ExecutionPlan<float16> plan{view};
+    plan.set_variable(0, float16{1});
+    plan.evaluate();
+    plan.backward();
+    EXPECT_EQ(static_cast<float>(plan.variable_grad(0)), 3000.f);
+    EXPECT_EQ(plan.variable_grads()[0], 3000.f);
+
+    constexpr size_t kLanes = 16;
+    BatchExecutionPlan<float16> batch{view, kLanes};
+    std::ranges::fill(batch.variable_lanes(0), float16{1});
+    batch.evaluate(kLanes);
+    batch.backward(kLanes);
+    for (size_t l = 0; l < kLanes; ++l) {
+        EXPECT_EQ(batch.variable_grads(0, kLanes)[l], 3000.f);
+    }
+}
+
+// Every backprop hop carries the adjoint in the accumulator type, in Node as in the plans, so
+// a multi-hop chain gets bit-identical gradients from both, and stays within a few ULPs of T
+// of the double graph (the forward values are still rounded to T at every node).
+TYPED_TEST(ReducedPrecisionTest, NodeMatchesPlanThroughAMultiHopChain) {
+    using T = TypeParam;
+    const T x_value{0.8};
+    const T y_value{0.6};
+    auto x = variable<T>("x");
+    auto y = variable<T>("y");
+    auto root = layered_chain(x, y);
+    const std::vector<std::byte> bytes = serialization::serialize(root);
+    const serialization::GraphView<T> view{bytes};
+
+    root->apply_variables({{"x", constant(x_value)}, {"y", constant(y_value)}});
+    root->evaluate();
+    root->get_gradients();
+
+    ExecutionPlan<T> plan{view};
+    const size_t xi = plan.variable_index("x");
+    const size_t yi = plan.variable_index("y");
+    plan.set_variable(xi, x_value);
+    plan.set_variable(yi, y_value);
+    EXPECT_EQ(plan.evaluate(), root->value());
+    plan.backward();
+    EXPECT_EQ(plan.variable_grads()[xi], x->wide_grad());
+    EXPECT_EQ(plan.variable_grads()[yi], y->wide_grad());
+    EXPECT_EQ(plan.variable_grad(xi), x->grad());
+
+    auto xd = constant(static_cast<double>(x_value));
+    auto yd = constant(static_cast<double>(y_value));
+    auto reference = layered_chain(xd, yd);
+    reference->get_gradients();
+    expect_close(root->value(), reference->value(), "value");
+    expect_close(x->grad(), xd->grad(), "d/dx");
+    expect_close(y->grad(), yd->grad(), "d/dy");
+}
+
+TYPED_TEST(ReducedPrecisionTest, BatchPlanMatchesDoublePlan) {
+    using T = TypeParam;
+    auto build = []<typename U>(ExpressionPtr<U> x) {
+        return grad::exp(grad::sin(x)) * grad::tanh(x) + grad::ln(grad::cos(x) + U{2});
+    };
+    const std::vector<std::byte> bytes = serialization::serialize(build(variable<T>("x")));
+    const std::vector<std::byte> reference_bytes = serialization::serialize(build(variable<double>("x")));
+    const serialization::GraphView<T> view{bytes};
+    const serialization::GraphView<double> reference_view{reference_bytes};
+    const auto value_type = std::is_same_v<T, float16> ? serialization::ValueType::FLOAT16
+                                                       : serialization::ValueType::BFLOAT16;
+    EXPECT_EQ(view.header().value_type, value_type);
+
+    constexpr size_t kLanes = 64;
+    BatchExecutionPlan<T> plan{view, kLanes};
+    BatchExecutionPlan<double> reference{reference_view, kLanes};
+    auto lanes = plan.variable_lanes(0);
+    auto reference_lanes = reference.variable_lanes(0);
+    for (size_t l = 0; l < kLanes; ++l) {
+        lanes[l] = T{0.05 * static_cast<double>(l) - 1.5};
+        reference_lanes[l] = static_cast<double>(lanes[l]);
+    }
+    plan.evaluate(kLanes);
+    plan.backward(kLanes);
+    reference.evaluate(kLanes);
+    reference.backward(kLanes, 4.0);
+    for (size_t l = 0; l < kLanes; ++l) {
+        expect_close(plan.root_values(kLanes)[l], reference.root_values(kLanes)[l], "value");
+        expect_close(static_cast<T>(plan.variable_grads(0, kLanes)[l]), reference.variable_grads(0, kLanes)[l] / 4,
+                     "grad");
+    }
+}
+
+/**************************************
+             Loss scaling
+***************************************/
+// d loss / d w = a * a ~ 1e-8, below float16's smallest subnormal (~6e-8). Backprop carries it
+// in float, but it underflows wherever it's read back as float16.
+TEST(LossScalerTest, RescuesGradientsReadBackInT) {
+    const float16 a{1e-4};
+    auto w = constant(float16{1});
+    auto loss = w * constant(a) * constant(a);
+    ParameterBuffer<float16> params{{w}};
+    const double want = static_cast<double>(a) * static_cast<double>(a);
+    loss->evaluate();
+
+    loss->get_gradients();
+    EXPECT_EQ(static_cast<float>(w->grad()), 0.f);
+    params.gather_grads();
+    EXPECT_NEAR(params.grads()[0], want, want * 1e-2);
+
+    LossScaler<float16> scaler;
+    scaler.backward(loss);
+    EXPECT_NEAR(static_cast<double>(w->grad()) / scaler.scale(), want, want * 1e-2);
+}
+
+// Gradients from a plan's variable_grad() are float16: 1000 * scale must fit in 65504, so the
+// scale halves from 2^15 down to 2^6 and the overflowing steps are skipped.
+TEST(LossScalerTest, BacksOffOnOverflowAndSkipsTheStep) {
+    const std::vector<std::byte> bytes = serialization::serialize(variable<float16>("w") * constant(float16{1000}));
+    ExecutionPlan<float16> plan{serialization::GraphView<float16>{bytes}};
+    auto w = constant(float16{1});
+    ParameterBuffer<float16> params{{w}};
+    SGD<float16> sgd{{.learning_rate = 1e-4f}};
+    LossScaler<float16> scaler;
+
+    int skipped = 0;
+    while (true) {
+        plan.set_variable(0, w->value());
+        plan.evaluate();
+        plan.backward(scaler.seed());
+        params.grads()[0] = math::widen(plan.variable_grad(0));
+        if (scaler.step(sgd, params)) break;
+        ++skipped;
+        EXPECT_EQ(static_cast<float>(w->value()), 1.f);
+    }
+    EXPECT_EQ(skipped, 9);
+    EXPECT_EQ(scaler.scale(), 64.f);
+    EXPECT_NEAR(params.values()[0], 1.f - 1e-4f * 1000, 1e-3);
+    EXPECT_EQ(w->value(), float16{params.values()[0]});
+}
+
+TEST(LossScalerTest, GrowsAfterIntervalUpToLargestPowerOfTwo) {
+    LossScaler<float16> capped{{.initial_scale = 1e6f}};
+    EXPECT_EQ(capped.scale(), 32768.f);
+    EXPECT_EQ(capped.seed(), float16{32768});
+
+    LossScaler<float16> scaler{{.initial_scale = 8192.f, .growth_interval = 3}};
+    for (int i = 0; i < 3; ++i) scaler.update(true);
+    EXPECT_EQ(scaler.scale(), 16384.f);
+    for (int i = 0; i < 9; ++i) scaler.update(true);
+    EXPECT_EQ(scaler.scale(), 32768.f);
+    scaler.update(true);
+    scaler.update(false);
+    EXPECT_EQ(scaler.scale(), 16384.f);
+    EXPECT_EQ(scaler.good_steps(), 0u);
+}
+
+// 3001 isn't a float16 (the spacing there is 2): the buffer has to read the unrounded adjoint.
+TEST(ReducedPrecisionTrainTest, GatherReadsTheUnroundedAdjoint) {
+    auto w = constant(float16{1});
+    ExpressionPtr<float16> sum = w;
+    for (int i = 1; i < 3001; ++i) sum = sum + w;
+    ParameterBuffer<float16> params{{w}};
+    sum->evaluate();
+    sum->get_gradients();
+    EXPECT_NE(static_cast<float>(w->grad()), 3001.f);
+    EXPECT_EQ(w->wide_grad(), 3001.f);
+    params.gather_grads();
+    EXPECT_EQ(params.grads()[0], 3001.f);
+    params.gather_grads(Gather::ACCUMULATE);
+    EXPECT_EQ(params.grads()[0], 6002.f);
+}
+
+// Parameters keep float master weights: updates far below float16's resolution still land.
+TEST(ReducedPrecisionTrainTest, MasterWeightsAccumulateSmallUpdates) {
+    auto w = constant(float16{1});
+    auto loss = w * float16{1};
+    ParameterBuffer<float16> params{{w}};
+    SGD<float16> sgd{{.learning_rate = 1e-4f}};
+    for (int step = 0; step < 100; ++step) {
+        loss->evaluate();
+        loss->get_gradients();
+        params.gather_grads();
+        sgd.step(params);
+    }
+    EXPECT_NEAR(params.values()[0], 0.99f, 1e-5f);
+    EXPECT_EQ(w->value(), float16{0.99f});
+}
@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "autodiff/execution_plan.h"
+#include "autodiff/functions.h"
+#include "autodiff/kernels/transcendental.h"
+#include "autodiff/serialization.h"
+
+namespace {
+
+using namespace grad;
+using grad::kernels::Accuracy;
+
+constexpr size_t kSamples = 1 << 16;
+
+// Distance from `got` to the long double reference, in units of the float type's ULP at the
+// (rounded) reference value.
+template <typename T>
+double ulp_error(T got, long double want) {
+    const T rounded = static_cast<T>(want);
+    if (std::isnan(rounded)) {
+        return std::isnan(got) ? 0.0 : std::numeric_limits<double>::infinity();
+    }
+    if (got == rounded) {
+        return 0.0;
+    }
+    if (std::isinf(rounded) || std::isinf(got)) {
+        return std::numeric_limits<double>::infinity();
+    }
+    const T magnitude = std::abs(rounded);
+    T ulp = std::nextafter(magnitude, std::numeric_limits<T>::infinity()) - magnitude;
+    if (magnitude < std::numeric_limits<T>::min()) {
+        ulp = std::numeric_limits<T>::denorm_min();
+    }
+    return static_cast<double>(std::abs((static_cast<long double>(got) - want) / ulp));
+}
+
+template <typename T>
+std::vector<T> uniform(T lo, T hi, uint64_t seed) {
+    std::mt19937_64 rng{seed};
+    std::uniform_real_distribution<T> dist{lo, hi};
+    std::vector<T> x(kSamples);
+    for (T& v : x) v = dist(rng);
+    return x;
+}
+
+// Log-uniform positive samples, for log over many binades.
+template <typename T>
+std::vector<T> log_uniform(T lo, T hi, uint64_t seed) {
+    std::mt19937_64 rng{seed};
+    std::uniform_real_distribution<long double> dist{std::log(static_cast<long double>(lo)),
+                                                     std::log(static_cast<long double>(hi))};
+    std::vector<T> x(kSamples);
+    for (T& v : x) v = static_cast<T>(std::exp(dist(rng)));
+    return x;
+}
+
+template <typename T, typename Kernel, typename Reference>
+double max_ulp_error(const std::vector<T>& x, Kernel kernel, Reference reference) {
+    std::vector<T> y(x.size());
+    kernel(x.data(), y.data(), x.size(), Accuracy::FAST);
+    double worst = 0;
+    for (size_t i = 0; i < x.size(); ++i) {
+        worst = std::max(worst, ulp_error(y[i], reference(static_cast<long double>(x[i]))));
+    }
+    return worst;
+}
+
+template <typename T>
+class KernelsTest : public ::testing::Test {};
+
+using KernelTypes = ::testing::Types<float, double>;
+
+}  // namespace
+
+TYPED_TEST_SUITE(KernelsTest, KernelTypes);
+
+/**************************************
+            Accuracy sweeps
+***************************************/
+TYPED_TEST(KernelsTest, ExpWithinTwoUlp) {
+    using T = TypeParam;
+    const T lo = sizeof(T) == 4 ? T(-100) : T(-740);
+    const T hi = sizeof(T) == 4 ? T(88) : T(709);
+    EXPECT_LE(max_ulp_error(uniform(lo, hi, 1), kernels::exp<T>, [](long double v) { return std::exp(v); }), 2.0);
+    EXPECT_LE(max_ulp_error(uniform(T(-1), T(1), 2), kernels::exp<T>, [](long double v) { return std::exp(v); }),
+              2.0);
+}
+
+TYPED_TEST(KernelsTest, LogWithinTwoUlp) {
+    using T = TypeParam;
+    const T lo = std::numeric_limits<T>::denorm_min() * 16;
+    const T hi = std::numeric_limits<T>::max() / 2;
+    EXPECT_LE(max_ulp_error(log_uniform(lo, hi, 3), kernels::log<T>, [](long double v) { return std::log(v); }),
+              2.0);
+    EXPECT_LE(max_ulp_error(uniform(T(0.5), T(2), 4), kernels::log<T>, [](long double v) { return std::log(v); }),
+              2.0);
+}
+
+TYPED_TEST(KernelsTest, SinCosWithinTwoUlpOnModerateArguments) {
+    using T = TypeParam;
+    const auto x = uniform(T(-1000), T(1000), 5);
+    EXPECT_LE(max_ulp_error(x, kernels::sin<T>, [](long double v) { return std::sin(v); }), 2.0);
+    EXPECT_LE(max_ulp_error(x, kernels::cos<T>, [](long double v) { return std::cos(v); }), 2.0);
+}
+
+TYPED_TEST(KernelsTest, SinCosWithinTwoAndAHalfUlpOverFastRange) {
+    using T = TypeParam;
+    const T limit = sizeof(T) == 4 ? T(8192) : T(1e5);
+    const auto x = uniform(-limit, limit, 6);
+    EXPECT_LE(max_ulp_error(x, kernels::sin<T>, [](long double v) { return std::sin(v); }), 2.5);
+    EXPECT_LE(max_ulp_error(x, kernels::cos<T>, [](long double v) { return std::cos(v); }), 2.5);
+}
+
+TYPED_TEST(KernelsTest, TanhWithinThreeUlp) {
+    using T = TypeParam;
+    EXPECT_LE(max_ulp_error(uniform(T(-25), T(25), 7), kernels::tanh<T>, [](long double v) { return std::tanh(v); }),
+              3.0);
+    EXPECT_LE(max_ulp_error(uniform(T(-0.01), T(0.01), 8), kernels::tanh<T>,
+                            [](long double v) { return std::tanh(v); }),
+              3.0);
+}
+
+/**************************************
+            Special values
+***************************************/
+TYPED_TEST(KernelsTest, SpecialValues) {
+    using T = TypeParam;
+    using limits = std::numeric_limits<T>;
+    const T inf = limits::infinity();
+    const T nan = limits::quiet_NaN();
+    const std::vector<T> x = {T(0), T(-0.0), inf, -inf, nan, limits::denorm_min(), limits::min() / 4,
+                              T(-1), T(1e30), T(-1e30), T(1000), T(-1000)};
+    std::vector<T> y(x.size());
+
+    auto check = [&](auto kernel, auto reference, const char* name) {
+        kernel(x.data(), y.data(), x.size(), Accuracy::FAST);
+        for (size_t i = 0; i < x.size(); ++i) {
+            const T want = reference(x[i]);
+            if (std::isnan(want)) {
+                EXPECT_TRUE(std::isnan(y[i])) << name << "(" << x[i] << ") = " << y[i];
+            } else if (std::isinf(want) || want == 0) {
+                EXPECT_EQ(y[i], want) << name << "(" << x[i] << ")";
+            } else {
+                EXPECT_LE(ulp_error(y[i], static_cast<long double>(want)), 3.0)
+                    << name << "(" << x[i] << ") = " << y[i] << ", want " << want;
+            }
+        }
+    };
+    check(kernels::exp<T>, [](T v) { return std::exp(v); }, "exp");
+    check(kernels::log<T>, [](T v) { return std::log(v); }, "log");
+    check(kernels::sin<T>, [](T v) { return std::sin(v); }, "sin");
+    check(kernels::cos<T>, [](T v) { return std::cos(v); }, "cos");
+    check(kernels::tanh<T>, [](T v) { return std::tanh(v); }, "tanh");
+}
+
+// Lengths that are not a multiple of the vector width go through the padded tail.
+TYPED_TEST(KernelsTest, OddLengthsAndInPlace) {
+    using T = TypeParam;
+    for (size_t n : {size_t{0}, size_t{1}, size_t{3}, size_t{13}, size_t{67}}) {
+        std::vector<T> x(n);
+        for (size_t i = 0; i < n; ++i) x[i] = T(0.1) * static_cast<T>(i) - T(2);
+        std::vector<T> y = x;
+        kernels::exp(y.data(), y.data(), n, Accuracy::FAST);
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_LE(ulp_error(y[i], std::exp(static_cast<long double>(x[i]))), 2.0);
+        }
+    }
+}
+
+TYPED_TEST(KernelsTest, ExactMatchesLibm) {
+    using T = TypeParam;
+    const auto x = uniform(T(-5), T(5), 9);
+    std::vector<T> y(x.size());
+    kernels::sin(x.data(), y.data(), x.size(), Accuracy::EXACT);
+    for (size_t i = 0; i < x.size(); ++i) EXPECT_EQ(y[i], std::sin(x[i]));
+    kernels::tanh(x.data(), y.data(), x.size(), Accuracy::EXACT);
+    for (size_t i = 0; i < x.size(); ++i) EXPECT_EQ(y[i], std::tanh(x[i]));
+}
+
+/**************************************
+               Backward
+***************************************/
+TYPED_TEST(KernelsTest, BackwardAccumulates) {
+    using T = TypeParam;
+    const std::vector<T> x = {T(-1.5), T(-0.25), T(0.5), T(1), T(2.5)};
+    const std::vector<T> g = {T(1), T(2), T(-1), T(0.5), T(3)};
+    const size_t n = x.size();
+    std::vector<T> y(n);
+
+    const double tolerance = std::is_same_v<T, float> ? 1e-5 : 1e-12;
+    auto expect_grads = [&](const std::vector<T>& gx, auto derivative) {
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_NEAR(gx[i], T(1) + derivative(x[i]) * g[i], tolerance);
+        }
+    };
+
+    std::vector<T> gx(n, T(1));
+    kernels::exp(x.data(), y.data(), n, Accuracy::FAST);
+    kernels::exp_backward(y.data(), g.data(), gx.data(), n);
+    expect_grads(gx, [](T v) { return std::exp(v); });
+
+    gx.assign(n, T(1));
+    kernels::tanh(x.data(), y.data(), n, Accuracy::FAST);
+    kernels::tanh_backward(y.data(), g.data(), gx.data(), n);
+    expect_grads(gx, [](T v) { return 1 - std::tanh(v) * std::tanh(v); });
+
+    gx.assign(n, T(1));
+    kernels::sin_backward(x.data(), g.data(), gx.data(), n);
+    expect_grads(gx, [](T v) { return std::cos(v); });
+
+    gx.assign(n, T(1));
+    kernels::cos_backward(x.data(), g.data(), gx.data(), n);
+    expect_grads(gx, [](T v) { return -std::sin(v); });
+}
+
+/**************************************
+          Batch plan integration
+***************************************/
+TEST(KernelsBatchPlanTest, FastAccuracyTracksExact) {
+    auto x = variable<double>("x");
+    auto root = grad::exp(grad::sin(x)) * grad::tanh(x) + grad::ln(grad::cos(x) + 2.0);
+    const std::vector<std::byte> bytes = serialization::serialize(root);
+    const serialization::GraphView<double> view{bytes};
+
+    constexpr size_t kLanes = 101;
+    BatchExecutionPlan<double> exact{view, kLanes};
+    BatchExecutionPlan<double> fast{view, kLanes, Accuracy::FAST};
+    for (auto* plan : {&exact, &fast}) {
+        auto lanes = plan->variable_lanes(0);
+        for (size_t l = 0; l < kLanes; ++l) lanes[l] = 0.05 * static_cast<double>(l) - 2.5;
+        plan->evaluate(kLanes);
+        plan->backward(kLanes);
+    }
+    for (size_t l = 0; l < kLanes; ++l) {
+        EXPECT_NEAR(fast.root_values(kLanes)[l], exact.root_values(kLanes)[l], 1e-14);
+        EXPECT_NEAR(fast.variable_grads(0, kLanes)[l], exact.variable_grads(0, kLanes)[l], 1e-13);
+    }
+}
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "autodiff/functions.h"
+#include "autodiff/optimizer/ir.h"
+#include "autodiff/optimizer/memory_planner.h"
+
+namespace {
+
+using namespace grad;
+using namespace grad::optimizer;
+
+ValueId find_constant(const IR<double>& ir, double value) {
+    for (ValueId v = 0; v < ir.size(); ++v) {
+        if (ir.op(v) == Op::CONSTANT && ir.constant_value(v) == value) return v;
+    }
+    ADD_FAILURE() << "no constant " << value;
+    return kNoValue;
+}
+
+// No two intervals sharing a buffer may overlap, and the pool is no larger than the most
+// intervals live at one step.
+void expect_valid_packing(const MemoryPlan& plan) {
+    const uint32_t steps = 2 * plan.value_count;
+    std::vector<std::vector<int>> owners(steps, std::vector<int>(plan.buffer_count, -1));
+    uint32_t peak = 0;
+    for (uint32_t s = 0; s < steps; ++s) {
+        uint32_t live = 0;
+        for (ValueId v = 0; v < plan.value_count; ++v) {
+            for (bool grad : {false, true}) {
+                const LiveInterval& interval = grad ? plan.grad_intervals[v] : plan.value_intervals[v];
+                if (interval.empty() || s < interval.start || s > interval.end) continue;
+                const uint32_t buffer = grad ? plan.grad_buffers[v] : plan.value_buffers[v];
+                ASSERT_LT(buffer, plan.buffer_count);
+                EXPECT_EQ(owners[s][buffer], -1) << "buffer " << buffer << " shared at step " << s;
+                owners[s][buffer] = static_cast<int>(2 * v + grad);
+                ++live;
+            }
+        }
+        peak = std::max(peak, live);
+    }
+    EXPECT_EQ(plan.buffer_count, peak);
+}
+
+// Leaves: x, y, then one weight per tanh layer. The leaf nodes go to `nodes` if given.
+ExpressionPtr<double> build_model(const std::vector<double>& leaves,
+                                  std::vector<ExpressionPtr<double>>* nodes = nullptr) {
+    std::vector<ExpressionPtr<double>> leaf_nodes;
+    for (double leaf : leaves) leaf_nodes.push_back(constant(leaf));
+    const auto& x = leaf_nodes[0];
+    const auto& y = leaf_nodes[1];
+    ExpressionPtr<double> h = x;
+    for (size_t layer = 2; layer < leaves.size(); ++layer) {
+        h = grad::tanh(h * leaf_nodes[layer] + y);
+    }
+    auto root = grad::exp(h) * grad::sin(x) + grad::ln(h + constant(2.5)) * h + constant(2.0)->pow(h) / y +
+                grad::cos(x * y);
+    root->evaluate();
+    if (nodes) *nodes = std::move(leaf_nodes);
+    return root;
+}
+
+}  // namespace
+
+TEST(MemoryPlannerTest, IntervalsFollowWhatBackwardReads) {
+    auto x = constant(0.5);
+    auto y = constant(1.5);
+    // ids: x 0, y 1, x + y 2, exp 3, * 4
+    auto sum = x + y;
+    auto root = grad::exp(sum) * sum;
+    IR<double> ir = IR<double>::lower(root);
+    ASSERT_EQ(ir.size(), 5u);
+    const MemoryPlan plan = plan_memory(ir);
+    EXPECT_EQ(plan.backward_step(4), 5u);
+    EXPECT_EQ(plan.backward_step(0), 9u);
+
+    // Leaf values aren't planned; leaf adjoints start at the ADD's backward step and stay.
+    EXPECT_TRUE(plan.value_intervals[0].empty());
+    EXPECT_EQ(plan.grad_intervals[0].start, plan.backward_step(2));
+    EXPECT_EQ(plan.grad_intervals[0].end, 9u);
+    // x + y is read by MUL's backward rule; exp keeps its own output for backward.
+    EXPECT_EQ(plan.value_intervals[2].start, 2u);
+    EXPECT_EQ(plan.value_intervals[2].end, plan.backward_step(4));
+    EXPECT_EQ(plan.value_intervals[3].end, plan.backward_step(3));
+    // The root is seeded when backward starts.
+    EXPECT_EQ(plan.grad_intervals[4].start, 5u);
+    EXPECT_EQ(plan.grad_intervals[4].end, 5u);
+    // Accumulated first by the MUL, finished at its own backward step.
+    EXPECT_EQ(plan.grad_intervals[2].start, plan.backward_step(4));
+    EXPECT_EQ(plan.grad_intervals[2].end, plan.backward_step(2));
+    expect_valid_packing(plan);
+}
+
+TEST(MemoryPlannerTest, AddOperandsDieAtTheirUser) {
+    auto x = constant(1.0);
+    ExpressionPtr<double> chain = x;
+    for (int i = 0; i < 50; ++i) chain = chain + x;
+    IR<double> ir = IR<double>::lower(chain);
+    const MemoryPlan forward = plan_memory(ir, {.backward = false});
+    // Each sum is read once by the next: two buffers ping-pong down the chain.
+    EXPECT_EQ(forward.planned_count, 50u);
+    EXPECT_EQ(forward.buffer_count, 2u);
+    expect_valid_packing(forward);
+
+    // With backward, ADD keeps nothing alive either; only the adjoints hand over one by one,
+    // next to x's accumulated adjoint.
+    const MemoryPlan both = plan_memory(ir);
+    EXPECT_EQ(both.planned_count, 101u);
+    EXPECT_LE(both.buffer_count, 3u);
+    expect_valid_packing(both);
+}
+
+// Runs forward and backward reading and writing only the plan's buffers, and checks the leaf
+// adjoints against Node's backward pass and central differences.
+TEST(MemoryPlannerTest, PlannedExecutionMatchesNodeAndFiniteDifferences) {
+    const std::vector<double> leaves{0.7, 1.3, 0.3, 0.4, 0.5, 0.6};
+    std::vector<ExpressionPtr<double>> nodes;
+    const ExpressionPtr<double> root = build_model(leaves, &nodes);
+    root->get_gradients();
+    IR<double> ir = IR<double>::lower(root);
+    const MemoryPlan plan = plan_memory(ir, {.lanes = 1});
+    expect_valid_packing(plan);
+    EXPECT_LT(plan.planned_bytes(), plan.naive_bytes());
+
+    const uint32_t n = plan.value_count;
+    std::vector<double> pool(plan.buffer_count);
+    auto value = [&](ValueId v) -> double {
+        return ir.is_leaf(v) ? ir.constant_value(v) : pool[plan.value_buffers[v]];
+    };
+    for (ValueId v = 0; v < n; ++v) {
+        if (ir.is_leaf(v)) continue;
+        const auto in = ir.operands(v);
+        const double a = value(in[0]);
+        const double b = in.size() > 1 ? value(in[1]) : 0.0;
+        double out = 0.0;
+        switch (ir.op(v)) {
+            case Op::ADD: out = a + b; break;
+            case Op::SUB: out = a - b; break;
+            case Op::MUL: out = a * b; break;
+            case Op::DIV: out = a / b; break;
+            case Op::POW: out = std::pow(a, b); break;
+            case Op::SIN: out = std::sin(a); break;
+            case Op::COS: out = std::cos(a); break;
+            case Op::EXP: out = std::exp(a); break;
+            case Op::TANH: out = std::tanh(a); break;
+            case Op::LN: out = std::log(a); break;
+            default: FAIL() << "unexpected op";
+        }
+        pool[plan.value_buffers[v]] = out;
+    }
+    EXPECT_NEAR(value(ir.root()), root->value(), 1e-12);
+
+    // Buffers are reused, so an adjoint is assigned by the first accumulation into it.
+    std::vector<bool> started(n, false);
+    auto accumulate = [&](ValueId v, double g) {
+        double& slot = pool[plan.grad_buffers[v]];
+        slot = started[v] ? slot + g : g;
+        started[v] = true;
+    };
+    accumulate(ir.root(), 1.0);
+    for (ValueId v = n; v-- > 0;) {
+        if (ir.is_leaf(v)) continue;
+        const auto in = ir.operands(v);
+        const double g = pool[plan.grad_buffers[v]];
+        const double a = value(in[0]);
+        switch (ir.op(v)) {
+            case Op::ADD: accumulate(in[0], g); accumulate(in[1], g); break;
+            case Op::SUB: accumulate(in[0], g); accumulate(in[1], -g); break;
+            case Op::MUL: accumulate(in[0], g * value(in[1])); accumulate(in[1], g * a); break;
+            case Op::DIV:
+                accumulate(in[0], g / value(in[1]));
+                accumulate(in[1], -g * a / (value(in[1]) * value(in[1])));
+                break;
+            case Op::POW:
+                accumulate(in[0], g * value(in[1]) * std::pow(a, value(in[1]) - 1));
+                accumulate(in[1], g * std::log(a) * value(v));
+                break;
+            case Op::SIN: accumulate(in[0], g * std::cos(a)); break;
+            case Op::COS: accumulate(in[0], -g * std::sin(a)); break;
+            case Op::EXP: accumulate(in[0], g * value(v)); break;
+            case Op::TANH: accumulate(in[0], g * (1 - value(v) * value(v))); break;
+            case Op::LN: accumulate(in[0], g / a); break;
+            default: FAIL() << "unexpected op";
+        }
+    }
+
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        constexpr double h = 1e-6;
+        std::vector<double> up = leaves;
+        std::vector<double> down = leaves;
+        up[i] += h;
+        down[i] -= h;
+        const double want = (build_model(up)->value() - build_model(down)->value()) / (2 * h);
+        const double planned = pool[plan.grad_buffers[find_constant(ir, leaves[i])]];
+        EXPECT_NEAR(planned, want, 1e-6) << "leaf " << i;
+        EXPECT_NEAR(planned, nodes[i]->grad(), 1e-12) << "leaf " << i;
+    }
+}
+
+TEST(MemoryPlannerTest, SummaryReportsPlannedAgainstNaiveBytes) {
+    auto x = constant(1.0f);
+    ExpressionPtr<float> chain = x;
+    for (int i = 0; i < 4; ++i) chain = chain + x;
+    const MemoryPlan plan = plan_memory(IR<float>::lower(chain), {.backward = false, .lanes = 8});
+    EXPECT_EQ(plan.buffer_bytes, 32u);
+    EXPECT_EQ(plan.summary(), "4 buffers in a pool of 2: 64 bytes planned vs 128 naive (50% saved)");
+}
@@ -1,10 +1,16 @@
 #include <gtest/gtest.h>
 
+#include <cmath>
 #include <numbers>
+#include <string>
 
 #include "autodiff/functions.h"
+#include "autodiff/optimizer/ir.h"
 #include "autodiff/optimizer/optimizer.h"
+#include "autodiff/optimizer/passes/common_subexpression_elim.h"
 #include "autodiff/optimizer/passes/constant_folding.h"
+#include "autodiff/optimizer/passes/dead_code_elim.h"
+#include "autodiff/train/optimizers.h"
 
 TEST(OptimizerTest, TestConstantFolding) {
     using namespace grad;
@@ -36,3 +42,182 @@ TEST(OptimizerTest, TestConstantFolding) {
 
     EXPECT_FLOAT_EQ(original_value, optimized_value);
 }
+
+namespace {
+
+using namespace grad;
+using namespace grad::optimizer;
+
+std::vector<std::shared_ptr<Pass<double>>> all_passes() {
+    return {std::make_shared<ConstantFoldingPass<double>>(), std::make_shared<CommonSubexpressionElimPass<double>>(),
+            std::make_shared<DeadCodeElimPass<double>>()};
+}
+
+}  // namespace
+
+TEST(OptimizerIRTest, LowersIntoTopologicalSSA) {
+    auto x = variable<double>("x");
+    auto other_x = variable<double>("x");
+    auto c = constant(3.0);
+    auto root = (x * c) + (other_x * x);
+
+    IR<double> ir = IR<double>::lower(root);
+    ASSERT_EQ(ir.size(), 5u);  // x, c, x * c, x * x, +
+    EXPECT_EQ(ir.root(), 4u);
+    for (ValueId v = 0; v < ir.size(); ++v) {
+        for (ValueId operand : ir.operands(v)) {
+            EXPECT_LT(operand, v);
+        }
+    }
+
+    // Both variables named x lowered to one value, used once by x * c and twice by x * x.
+    const ValueId x_id = ir.operands(ir.operands(ir.root())[0])[0];
+    EXPECT_EQ(ir.op(x_id), Op::VARIABLE);
+    EXPECT_EQ(ir.variable_name(x_id), "x");
+    EXPECT_EQ(ir.use_count(x_id), 3u);
+    std::vector<ValueId> users;
+    ir.for_each_user(x_id, [&](ValueId user) { users.push_back(user); });
+    EXPECT_EQ(users.size(), 3u);
+    EXPECT_EQ(ir.use_count(ir.root()), 0u);
+}
+
+TEST(OptimizerIRTest, RaiseReusesLeafNodes) {
+    auto w = constant(2.0);
+    auto x = variable<double>("x");
+    auto raised = IR<double>::lower(grad::sin(w * x)).raise();
+    EXPECT_EQ(raised->to_string(), "SIN(MUL(Const(2.000000), Var(x)))");
+    EXPECT_EQ(raised->get_inputs()[0]->get_inputs()[0], w);
+    EXPECT_EQ(raised->get_inputs()[0]->get_inputs()[1], x);
+}
+
+TEST(OptimizerIRTest, ReplaceAllUsesMovesUsersAndCounts) {
+    auto a = constant(1.0);
+    auto b = constant(2.0);
+    auto root = (a + b) * (a * b);
+    IR<double> ir = IR<double>::lower(root);
+    const ValueId a_id = 0;
+    const ValueId b_id = 1;
+    ASSERT_EQ(ir.constant_value(a_id), 1.0);
+    ASSERT_EQ(ir.constant_value(b_id), 2.0);
+
+    ir.replace_all_uses(b_id, a_id);
+    EXPECT_EQ(ir.use_count(a_id), 4u);
+    EXPECT_EQ(ir.use_count(b_id), 0u);
+    size_t visited = 0;
+    ir.for_each_user(a_id, [&](ValueId user) {
+        ++visited;
+        for (ValueId operand : ir.operands(user)) EXPECT_EQ(operand, a_id);
+    });
+    EXPECT_EQ(visited, 4u);
+    ir.for_each_user(b_id, [](ValueId) { ADD_FAILURE() << "b has no users left"; });
+    EXPECT_EQ(ir.raise()->to_string(), "MUL(ADD(Const(1.000000), Const(1.000000)), MUL(Const(1.000000), Const(1.000000)))");
+}
+
+TEST(OptimizerIRTest, CommonSubexpressionElimMergesRepeatedWork) {
+    auto x = variable<double>("x");
+    auto y = variable<double>("y");
+    // (x * y) appears twice (once commuted), and so does the tanh over it.
+    auto root = grad::tanh(x * y) * grad::tanh(y * x) + grad::exp(x * y);
+
+    IR<double> ir = IR<double>::lower(root);
+    CommonSubexpressionElimPass<double>{}.apply_pass(ir);
+    DeadCodeElimPass<double>{}.apply_pass(ir);
+    EXPECT_EQ(ir.size(), 7u);  // x, y, x * y, tanh, tanh * tanh, exp, +
+    EXPECT_EQ(ir.live_count(), 7u);
+
+    auto optimized = ir.raise();
+    EXPECT_EQ(optimized->to_string(), "ADD(MUL(TANH(MUL(Var(x), Var(y))), TANH(MUL(Var(x), Var(y)))), EXP(MUL(Var(x), Var(y))))");
+    // Shared, not just printed the same.
+    EXPECT_EQ(optimized->get_inputs()[0]->get_inputs()[0], optimized->get_inputs()[0]->get_inputs()[1]);
+}
+
+TEST(OptimizerIRTest, CommonSubexpressionElimKeepsDistinctConstants) {
+    auto a = constant(2.0);
+    auto b = constant(2.0);
+    auto x = variable<double>("x");
+    IR<double> ir = IR<double>::lower(x * a + x * b);
+    CommonSubexpressionElimPass<double>{}.apply_pass(ir);
+    DeadCodeElimPass<double>{}.apply_pass(ir);
+    EXPECT_EQ(ir.size(), 6u);
+}
+
+TEST(OptimizerIRTest, DeadCodeElimCompactsAfterFolding) {
+    auto x = variable<double>("x");
+    auto folded = grad::exp(constant(0.0)) * constant(3.0);
+    IR<double> ir = IR<double>::lower(x + folded);
+    ASSERT_EQ(ir.size(), 6u);
+
+    ConstantFoldingPass<double>{}.apply_pass(ir);
+    EXPECT_EQ(ir.live_count(), 6u);
+    DeadCodeElimPass<double>{}.apply_pass(ir);
+    EXPECT_EQ(ir.size(), 3u);
+    EXPECT_EQ(ir.live_count(), 3u);
+    EXPECT_EQ(ir.use_count(0), 1u);
+    EXPECT_EQ(ir.raise()->to_string(), "ADD(Var(x), Const(3.000000))");
+}
+
+TEST(OptimizerIRTest, FullPipelinePreservesValuesAndGradients) {
+    // Variables can't be folded, so only the constant product folds and CSE/DCE have the
+    // repeated sin(a * b) to work on.
+    auto a = variable<double>("a");
+    auto b = variable<double>("b");
+    auto original = grad::sin(a * b) * grad::exp(b) + grad::sin(b * a) * (constant(2.0) * constant(0.5)) +
+                    grad::ln(a + b);
+    auto optimized = optimize(original, all_passes());
+    EXPECT_EQ(optimized->to_string(),
+              "ADD(ADD(MUL(SIN(MUL(Var(a), Var(b))), EXP(Var(b))), MUL(SIN(MUL(Var(a), Var(b))), Const(1.000000))), "
+              "LN(ADD(Var(a), Var(b))))");
+
+    // Binding after optimizing turns the shared variable nodes into the leaves both graphs
+    // backprop into.
+    optimized->apply_variables({{"a", constant(0.7)}, {"b", constant(1.3)}});
+    original->evaluate();
+    original->get_gradients();
+    const double value = original->value();
+    const double da = a->grad();
+    const double db = b->grad();
+
+    a->set_grad(123);
+    b->set_grad(123);
+    EXPECT_DOUBLE_EQ(optimized->evaluate(), value);
+    optimized->get_gradients();
+    EXPECT_DOUBLE_EQ(a->grad(), da);
+    EXPECT_DOUBLE_EQ(b->grad(), db);
+    EXPECT_NEAR(da, 1.3 * std::cos(0.91) * (std::exp(1.3) + 1) + 1 / 2.0, 1e-12);
+}
+
+// Folding treats leaf constants as constants, so trainable parameters have to be pinned or
+// they're folded into fresh nodes that training never reaches.
+TEST(OptimizerIRTest, PinnedParametersSurviveFolding) {
+    auto x = variable<double>("x");
+    auto w = constant(2.0);
+    auto root = x * (w * constant(3.0)) + grad::exp(w);
+    grad::train::ParameterBuffer<double> params{{w}};
+
+    auto unpinned = optimize(root, all_passes());
+    EXPECT_EQ(unpinned->to_string(), "ADD(MUL(Var(x), Const(6.000000)), Const(" + std::to_string(std::exp(2.0)) + "))");
+
+    auto optimized = optimize(root, all_passes(), params.parameters());
+    EXPECT_EQ(optimized->to_string(), "ADD(MUL(Var(x), MUL(Const(2.000000), Const(3.000000))), EXP(Const(2.000000)))");
+    EXPECT_EQ(optimized->get_inputs()[1]->get_inputs()[0], w);
+
+    optimized->apply_variables({{"x", constant(0.5)}});
+    grad::train::SGD<double> sgd{{.learning_rate = 0.1}};
+    optimized->evaluate();
+    optimized->get_gradients();
+    params.gather_grads();
+    EXPECT_DOUBLE_EQ(params.grads()[0], 0.5 * 3.0 + std::exp(2.0));
+    sgd.step(params);
+    EXPECT_DOUBLE_EQ(w->value(), 2.0 - 0.1 * (1.5 + std::exp(2.0)));
+    EXPECT_DOUBLE_EQ(optimized->evaluate(), 0.5 * w->value() * 3.0 + std::exp(w->value()));
+}
+
+TEST(OptimizerIRTest, LowersDeepChainsWithoutRecursion) {
+    auto x = constant(0.5);
+    ExpressionD chain = x;
+    for (int i = 0; i < 10000; ++i) chain = chain * 1.0;
+    IR<double> ir = IR<double>::lower(chain);
+    EXPECT_EQ(ir.size(), 20001u);
+    DeadCodeElimPass<double>{}.apply_pass(ir);
+    EXPECT_EQ(ir.size(), 20001u);
+}
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "autodiff/execution_plan.h"
+#include "autodiff/functions.h"
+#include "autodiff/pipeline.h"
+#include "autodiff/serialization.h"
+
+namespace {
+
+using namespace grad;
+using namespace grad::pipeline;
+
+constexpr size_t kRows = 1000;
+
+double x_of(size_t row) { return 0.001 * static_cast<double>(row); }
+double y_of(size_t row) { return 1.0 + 0.5 * static_cast<double>(row % 13); }
+
+// x * sin(y) + tanh(x * y)
+std::vector<std::byte> make_graph() {
+    auto x = variable<double>("x");
+    auto y = variable<double>("y");
+    return serialization::serialize(x * grad::sin(y) + grad::tanh(x * y));
+}
+
+std::string temp_path(const std::string& name) {
+    return ::testing::TempDir() + name;
+}
+
+std::vector<double> read_csv(const std::string& path, size_t columns) {
+    CsvRowReader<double> reader{path, columns};
+    std::vector<double> rows(kRows * columns + columns);
+    rows.resize(reader.read_rows(rows) * columns);
+    return rows;
+}
+
+// Checks every output row against a scalar plan bound to the same inputs.
+void expect_matches_plan(const serialization::GraphView<double>& view, const std::vector<double>& out) {
+    ExecutionPlan<double> plan{view};
+    const size_t x = plan.variable_index("x");
+    const size_t y = plan.variable_index("y");
+    ASSERT_EQ(out.size(), kRows * 3);
+    for (size_t row = 0; row < kRows; ++row) {
+        plan.set_variable(x, x_of(row));
+        plan.set_variable(y, y_of(row));
+        ASSERT_DOUBLE_EQ(out[row * 3], plan.evaluate()) << "row " << row;
+        plan.backward();
+        ASSERT_DOUBLE_EQ(out[row * 3 + 1], plan.variable_grad(x)) << "row " << row;
+        ASSERT_DOUBLE_EQ(out[row * 3 + 2], plan.variable_grad(y)) << "row " << row;
+    }
+}
+
+}  // namespace
+
+TEST(PipelineTest, CsvInputWithGradients) {
+    const std::string in_path = temp_path("pipeline_in.csv");
+    const std::string out_path = temp_path("pipeline_out.csv");
+    {
+        std::ofstream in{in_path};
+        in << std::setprecision(17) << "id,y,x\n";
+        for (size_t row = 0; row < kRows; ++row) {
+            in << row << "," << y_of(row) << "," << x_of(row) << "\n";
+        }
+    }
+
+    std::vector<std::byte> bytes = make_graph();
+    serialization::GraphView<double> view{bytes};
+    ExecutionPlan<double> plan{view};
+
+    // Tiny read buffer, odd chunk and batch sizes to exercise every boundary.
+    CsvRowReader<double> reader{in_path, 3, /*skip_header=*/true, /*buffer_bytes=*/16};
+    CsvRowWriter<double> writer{out_path};
+    BatchPipeline<double> pipeline{view,
+                                   {{2, plan.variable_index("x")}, {1, plan.variable_index("y")}},
+                                   {.chunk_rows = 37, .batch_lanes = 8, .with_gradients = true}};
+    EXPECT_EQ(pipeline.output_columns(), 3u);
+    EXPECT_EQ(pipeline.run(reader, writer), kRows);
+
+    expect_matches_plan(view, read_csv(out_path, 3));
+    std::remove(in_path.c_str());
+    std::remove(out_path.c_str());
+}
+
+TEST(PipelineTest, BinaryInputWithoutGradients) {
+    const std::string in_path = temp_path("pipeline_in.bin");
+    const std::string out_path = temp_path("pipeline_out.bin");
+    {
+        std::vector<double> rows;
+        for (size_t row = 0; row < kRows; ++row) {
+            rows.push_back(x_of(row));
+            rows.push_back(y_of(row));
+        }
+        std::ofstream in{in_path, std::ios::binary};
+        in.write(reinterpret_cast<const char*>(rows.data()), rows.size() * sizeof(double));
+    }
+
+    std::vector<std::byte> bytes = make_graph();
+    serialization::GraphView<double> view{bytes};
+    ExecutionPlan<double> plan{view};
+
+    BinaryRowReader<double> reader{in_path, 2};
+    BinaryRowWriter<double> writer{out_path};
+    BatchPipeline<double> pipeline{view, {{0, plan.variable_index("x")}, {1, plan.variable_index("y")}},
+                                   {.chunk_rows = 128}};
+    EXPECT_EQ(pipeline.run(reader, writer), kRows);
+
+    BinaryRowReader<double> results{out_path, 1};
+    std::vector<double> out(kRows + 1);
+    ASSERT_EQ(results.read_rows(out), kRows);
+    for (size_t row = 0; row < kRows; ++row) {
+        plan.set_variable(plan.variable_index("x"), x_of(row));
+        plan.set_variable(plan.variable_index("y"), y_of(row));
+        ASSERT_DOUBLE_EQ(out[row], plan.evaluate()) << "row " << row;
+    }
+    std::remove(in_path.c_str());
+    std::remove(out_path.c_str());
+}
+
+TEST(PipelineTest, RejectsUnboundVariablesAndBadInput) {
+    std::vector<std::byte> bytes = make_graph();
+    serialization::GraphView<double> view{bytes};
+    EXPECT_THROW(BatchPipeline<double>(view, {{0, 0}}), std::runtime_error);
+
+    const std::string in_path = temp_path("pipeline_bad.csv");
+    const std::string out_path = temp_path("pipeline_bad_out.csv");
+    {
+        std::ofstream in{in_path};
+        in << "1,2\n3\n";
+    }
+    CsvRowReader<double> reader{in_path, 2};
+    CsvRowWriter<double> writer{out_path};
+    BatchPipeline<double> pipeline{view, {{0, 0}, {1, 1}}};
+    EXPECT_THROW(pipeline.run(reader, writer), std::runtime_error);
+    std::remove(in_path.c_str());
+    std::remove(out_path.c_str());
+}
+
+TEST(PipelineTest, RejectsZeroSizes) {
+    std::vector<std::byte> bytes = make_graph();
+    serialization::GraphView<double> view{bytes};
+    const std::vector<ColumnBinding> bindings{{0, 0}, {1, 1}};
+    EXPECT_THROW(BatchPipeline<double>(view, bindings, {.batch_lanes = 0}), std::invalid_argument);
+    EXPECT_THROW(BatchPipeline<double>(view, bindings, {.chunk_rows = 0}), std::invalid_argument);
+
+    const std::string path = temp_path("pipeline_zero.csv");
+    {
+        std::ofstream in{path};
+        in << "1,2\n";
+    }
+    EXPECT_THROW(CsvRowReader<double>(path, 0), std::invalid_argument);
+    EXPECT_THROW(CsvRowReader<double>(path, 2, false, 0), std::invalid_argument);
+    EXPECT_THROW(BinaryRowReader<double>(path, 0), std::invalid_argument);
+    std::remove(path.c_str());
+}
+
+TEST(PipelineTest, ChannelIsABoundedRing) {
+    grad::pipeline::detail::Channel<int> channel{2};
+    // Wraps around the ring several times, in order.
+    for (int i = 0; i < 5; ++i) {
+        channel.push(2 * i);
+        channel.push(2 * i + 1);
+        EXPECT_EQ(channel.pop(), 2 * i);
+        EXPECT_EQ(channel.pop(), 2 * i + 1);
+    }
+    channel.push(10);
+    channel.push(11);
+    EXPECT_THROW(channel.push(12), std::logic_error);
+    channel.close();
+    EXPECT_EQ(channel.pop(), 10);
+    EXPECT_EQ(channel.pop(), 11);
+    EXPECT_EQ(channel.pop(), std::nullopt);
+}
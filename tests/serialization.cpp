@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "autodiff/execution_plan.h"
+#include "autodiff/functions.h"
+#include "autodiff/serialization.h"
+
+namespace {
+
+using namespace grad;
+using namespace grad::serialization;
+
+// sin(x * y) + (x * y) ^ 2 + tanh(y) with x * y shared
+template <Numeric T>
+ExpressionPtr<T> make_graph(const ExpressionPtr<T>& x, const ExpressionPtr<T>& y) {
+    auto mul = x * y;
+    return grad::sin(mul) + mul->pow(static_cast<T>(2)) + grad::tanh(y);
+}
+
+// Rewrites header fields and reseals the header checksum, so only the layout checks can
+// reject the result.
+template <typename Mutate>
+std::vector<std::byte> with_header(std::vector<std::byte> bytes, Mutate mutate) {
+    Header header;
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+    mutate(header);
+    header.header_checksum = header_checksum(header);
+    std::memcpy(bytes.data(), &header, sizeof(Header));
+    return bytes;
+}
+
+void expect_invalid_layout(const std::vector<std::byte>& bytes) {
+    try {
+        GraphView<float> view{bytes, false};
+        ADD_FAILURE() << "layout accepted";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ(e.what(), "Serialized graph has an invalid layout");
+    }
+}
+
+std::string temp_path(const std::string& name) {
+    return ::testing::TempDir() + name;
+}
+
+}  // namespace
+
+TEST(SerializationTest, RoundTripPreservesStructure) {
+    auto expr = make_graph<double>(variable<double>("x"), variable<double>("y"));
+
+    std::vector<std::byte> bytes = serialize(expr);
+    GraphView<double> view{bytes};
+
+    // x, y, mul, sin, 2, pow, add, tanh, add
+    EXPECT_EQ(view.node_count(), 9u);
+    EXPECT_EQ(view.variable_count(), 2u);
+    EXPECT_EQ(view.to_string(), expr->to_string());
+    EXPECT_EQ(to_expression(view)->to_string(), expr->to_string());
+}
+
+TEST(SerializationTest, RoundTripPreservesEvaluationAndGradients) {
+    auto x = variable<double>("x");
+    auto y = variable<double>("y");
+    auto expr = make_graph(x, y);
+    std::vector<std::byte> bytes = serialize(expr);
+
+    GraphView<double> view{bytes};
+    auto rebuilt = to_expression(view);
+
+    std::unordered_map<std::string, ExpressionD> values{
+        {"x", constant(0.75)},
+        {"y", constant(-1.5)},
+    };
+    expr->apply_variables(values);
+    rebuilt->apply_variables(values);
+    const double expected = expr->evaluate();
+    expr->get_gradients();
+
+    EXPECT_DOUBLE_EQ(rebuilt->evaluate(), expected);
+
+    ExecutionPlan<double> plan{view};
+    plan.set_variable(plan.variable_index("x"), 0.75);
+    plan.set_variable(plan.variable_index("y"), -1.5);
+    EXPECT_DOUBLE_EQ(plan.evaluate(), expected);
+
+    plan.backward();
+    EXPECT_NEAR(plan.variable_grad(plan.variable_index("x")), x->grad(), 1e-12);
+    EXPECT_NEAR(plan.variable_grad(plan.variable_index("y")), y->grad(), 1e-12);
+
+    // The plan can be rebound without rebuilding anything.
+    plan.set_variable(plan.variable_index("x"), 0.0);
+    EXPECT_DOUBLE_EQ(plan.evaluate(), std::tanh(-1.5));
+}
+
+TEST(SerializationTest, MappedFileExecutesInPlace) {
+    auto expr = make_graph<float>(variable<float>("x"), variable<float>("y"));
+    const std::string path = temp_path("serialization_test_graph.adg");
+    save(expr, path);
+
+    {
+        MappedGraph<float> graph{path};
+        EXPECT_EQ(graph.view().to_string(), expr->to_string());
+
+        ExecutionPlan<float> plan{graph.view()};
+        plan.set_variable(plan.variable_index("x"), 2.f);
+        plan.set_variable(plan.variable_index("y"), 0.5f);
+        EXPECT_FLOAT_EQ(plan.evaluate(), std::sin(1.f) + 1.f + std::tanh(0.5f));
+    }
+    std::remove(path.c_str());
+}
+
+TEST(SerializationTest, VariablesWithTheSameNameShareASlot) {
+    auto expr = variable<float>("x") * variable<float>("x");
+    std::vector<std::byte> bytes = serialize(expr);
+    GraphView<float> view{bytes};
+    EXPECT_EQ(view.variable_count(), 1u);
+}
+
+TEST(SerializationTest, SetVariablesRejectsAMismatchedCount) {
+    auto expr = variable<float>("x") * variable<float>("y");
+    std::vector<std::byte> bytes = serialize(expr);
+    ExecutionPlan<float> plan{GraphView<float>{bytes}};
+    const std::vector<float> too_short{2.f};
+    const std::vector<float> too_long{2.f, 3.f, 4.f};
+    EXPECT_THROW(plan.set_variables(too_short), std::invalid_argument);
+    EXPECT_THROW(plan.set_variables(too_long), std::invalid_argument);
+
+    const std::vector<float> exact{2.f, 3.f};
+    plan.set_variables(exact);
+    EXPECT_FLOAT_EQ(plan.evaluate(), 6.f);
+}
+
+TEST(SerializationTest, RejectsCorruptedOrMismatchedData) {
+    auto expr = make_graph<float>(variable<float>("x"), constant(3.f));
+    std::vector<std::byte> bytes = serialize(expr);
+
+    std::vector<std::byte> corrupted_payload = bytes;
+    corrupted_payload.back() ^= std::byte{0x1};
+    EXPECT_THROW(GraphView<float>{corrupted_payload}, std::runtime_error);
+
+    std::vector<std::byte> corrupted_header = bytes;
+    corrupted_header[offsetof(Header, node_count)] ^= std::byte{0x1};
+    EXPECT_THROW(GraphView<float>{corrupted_header}, std::runtime_error);
+
+    std::vector<std::byte> truncated(bytes.begin(), bytes.begin() + sizeof(Header) - 1);
+    EXPECT_THROW(GraphView<float>{truncated}, std::runtime_error);
+
+    EXPECT_THROW(GraphView<double>{bytes}, std::runtime_error);
+}
+
+TEST(SerializationTest, RejectsCraftedHeaderLayouts) {
+    const std::vector<std::byte> bytes = serialize(make_graph<float>(variable<float>("x"), constant(3.f)));
+    GraphView<float>{with_header(bytes, [](Header&) {})};
+
+    // Offsets near 2^64 that would wrap `offset + count * size` past the bounds check.
+    expect_invalid_layout(with_header(bytes, [](Header& h) { h.nodes_offset = UINT64_MAX - 7; }));
+    expect_invalid_layout(with_header(bytes, [](Header& h) { h.constants_offset = UINT64_MAX - 7; }));
+    expect_invalid_layout(with_header(bytes, [](Header& h) {
+        h.variables_offset = UINT64_MAX - 7;
+        h.variable_count = 2;
+    }));
+    // Counts too large for their section.
+    expect_invalid_layout(with_header(bytes, [](Header& h) { h.constant_count = UINT32_MAX; }));
+    // Nodes overlapping the header.
+    expect_invalid_layout(with_header(bytes, [](Header& h) { h.nodes_offset = 0; }));
+    // Misaligned sections.
+    expect_invalid_layout(with_header(bytes, [](Header& h) { h.nodes_offset += 4; }));
+    expect_invalid_layout(with_header(bytes, [](Header& h) { h.constants_offset += 4; }));
+    expect_invalid_layout(with_header(bytes, [](Header& h) { h.variables_offset += 4; }));
+    expect_invalid_layout(with_header(bytes, [](Header& h) { h.strings_offset += 1; }));
+    expect_invalid_layout(with_header(bytes, [](Header& h) { h.strings_offset = h.total_size + 8; }));
+
+    // The buffer itself has to be aligned for the records to be read in place.
+    std::vector<std::byte> shifted(bytes.size() + 1);
+    std::memcpy(shifted.data() + 1, bytes.data(), bytes.size());
+    EXPECT_THROW((GraphView<float>{std::span{shifted}.subspan(1)}), std::runtime_error);
+}
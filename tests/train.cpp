@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "autodiff/functions.h"
+#include "autodiff/train/optimizers.h"
+#include "autodiff/train/parameters.h"
+
+// Counts heap allocations so tests can check that optimizer steps don't allocate.
+namespace {
+std::atomic<size_t> allocations{0};
+}  // namespace
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+using namespace grad;
+using namespace grad::train;
+
+// loss = sum_i (w_i - target_i)^2, so d loss / d w_i = 2 (w_i - target_i). Differences are
+// built as additions since Node's unary negation (and so subtraction) has no backprop yet.
+struct Quadratic {
+    std::vector<ExpressionD> weights;
+    ExpressionD loss;
+
+    explicit Quadratic(const std::vector<double>& initial, const std::vector<double>& targets) {
+        for (double w : initial) weights.push_back(constant(w));
+        loss = constant(0.0);
+        for (size_t i = 0; i < weights.size(); ++i) {
+            auto diff = weights[i] + (-targets[i]);
+            loss = loss + diff * diff;
+        }
+    }
+
+    void backward() {
+        loss->evaluate();
+        loss->get_gradients();
+    }
+};
+
+}  // namespace
+
+/**************************************
+            ParameterBuffer
+***************************************/
+TEST(ParameterBufferTest, RejectsNonLeavesAndDuplicates) {
+    auto w = constant(1.0);
+    ParameterBuffer<double> params;
+    EXPECT_EQ(params.add(w), 0u);
+    EXPECT_THROW(params.add(w), std::runtime_error);
+    EXPECT_THROW(params.add(variable<double>("x")), std::runtime_error);
+    EXPECT_THROW(params.add(w + 1.0), std::runtime_error);
+    EXPECT_EQ(params.size(), 1u);
+    EXPECT_EQ(params.index_of(w), 0u);
+}
+
+TEST(ParameterBufferTest, GatherAndScatter) {
+    Quadratic model{{1.0, -2.0}, {0.0, 0.0}};
+    ParameterBuffer<double> params{model.weights};
+    model.backward();
+
+    params.gather_grads();
+    EXPECT_DOUBLE_EQ(params.grads()[0], 2.0);
+    EXPECT_DOUBLE_EQ(params.grads()[1], -4.0);
+    EXPECT_EQ(params.accumulated(), 1u);
+
+    params.gather_grads(Gather::ACCUMULATE);
+    EXPECT_DOUBLE_EQ(params.grads()[1], -8.0);
+    EXPECT_EQ(params.accumulated(), 2u);
+
+    params.values()[0] = 5.0;
+    params.scatter_values();
+    EXPECT_DOUBLE_EQ(model.weights[0]->value(), 5.0);
+
+    model.weights[1]->set_value(7.0);
+    params.gather_values();
+    EXPECT_DOUBLE_EQ(params.values()[1], 7.0);
+}
+
+/**************************************
+              Optimizers
+***************************************/
+TEST(OptimizerTest, SgdMatchesPerNodeUpdate) {
+    Quadratic fused{{1.0, -2.0, 0.5}, {0.5, 1.0, -1.0}};
+    Quadratic reference{{1.0, -2.0, 0.5}, {0.5, 1.0, -1.0}};
+    ParameterBuffer<double> params{fused.weights};
+    SGD<double> sgd{{.learning_rate = 0.1}};
+
+    for (int step = 0; step < 5; ++step) {
+        fused.backward();
+        params.gather_grads();
+        sgd.step(params);
+
+        reference.backward();
+        for (auto& w : reference.weights) w->set_value(w->value() - 0.1 * w->grad());
+    }
+    for (size_t i = 0; i < fused.weights.size(); ++i) {
+        EXPECT_DOUBLE_EQ(fused.weights[i]->value(), reference.weights[i]->value());
+    }
+}
+
+TEST(OptimizerTest, MomentumMatchesReference) {
+    for (bool nesterov : {false, true}) {
+        Quadratic model{{1.0, -2.0}, {0.0, 0.0}};
+        ParameterBuffer<double> params{model.weights};
+        Momentum<double> momentum{{.learning_rate = 0.05, .momentum = 0.9, .nesterov = nesterov}};
+
+        std::vector<double> w = {1.0, -2.0};
+        std::vector<double> velocity(2, 0.0);
+        for (int step = 0; step < 10; ++step) {
+            model.backward();
+            params.gather_grads();
+            momentum.step(params);
+
+            for (size_t i = 0; i < w.size(); ++i) {
+                const double g = 2 * w[i];
+                velocity[i] = 0.9 * velocity[i] + g;
+                w[i] -= 0.05 * (nesterov ? g + 0.9 * velocity[i] : velocity[i]);
+            }
+        }
+        for (size_t i = 0; i < w.size(); ++i) {
+            EXPECT_NEAR(model.weights[i]->value(), w[i], 1e-12) << "nesterov=" << nesterov;
+        }
+    }
+}
+
+TEST(OptimizerTest, AdamMatchesTextbookUpdate) {
+    Quadratic model{{1.0, -2.0, 3.0}, {0.0, 0.0, 0.0}};
+    ParameterBuffer<double> params{model.weights};
+    Adam<double> adam{{.learning_rate = 0.1}};
+
+    std::vector<double> w = {1.0, -2.0, 3.0};
+    std::vector<double> m(3, 0.0);
+    std::vector<double> v(3, 0.0);
+    for (int t = 1; t <= 20; ++t) {
+        model.backward();
+        params.gather_grads();
+        adam.step(params);
+
+        for (size_t i = 0; i < w.size(); ++i) {
+            const double g = 2 * w[i];
+            m[i] = 0.9 * m[i] + 0.1 * g;
+            v[i] = 0.999 * v[i] + 0.001 * g * g;
+            const double m_hat = m[i] / (1 - std::pow(0.9, t));
+            const double v_hat = v[i] / (1 - std::pow(0.999, t));
+            w[i] -= 0.1 * m_hat / (std::sqrt(v_hat) + 1e-8);
+        }
+    }
+    EXPECT_EQ(adam.steps(), 20u);
+    for (size_t i = 0; i < w.size(); ++i) {
+        EXPECT_NEAR(model.weights[i]->value(), w[i], 1e-12);
+    }
+}
+
+TEST(OptimizerTest, AccumulatedGradientsAreAveraged) {
+    // Two minibatches with different targets average to the midpoint's gradient.
+    auto w = constant(1.0);
+    auto loss_a = w * w;
+    auto loss_b = (w + -2.0) * (w + -2.0);
+    ParameterBuffer<double> params{{w}};
+    SGD<double> sgd{{.learning_rate = 0.25}};
+
+    params.zero_grads();
+    for (auto* loss : {&loss_a, &loss_b}) {
+        (*loss)->evaluate();
+        (*loss)->get_gradients();
+        params.gather_grads(Gather::ACCUMULATE);
+    }
+    sgd.step(params);
+    // mean grad = (2 * 1 + 2 * (1 - 2)) / 2 = 0
+    EXPECT_DOUBLE_EQ(w->value(), 1.0);
+}
+
+TEST(OptimizerTest, GradientClipping) {
+    Quadratic model{{3.0, 4.0}, {0.0, 0.0}};  // grads (6, 8), norm 10
+    ParameterBuffer<double> params{model.weights};
+    model.backward();
+    params.gather_grads();
+
+    SGD<double> by_norm{{.learning_rate = 1.0, .clipping = {.max_norm = 5.0}}};
+    by_norm.step(params);
+    EXPECT_DOUBLE_EQ(params.values()[0], 0.0);
+    EXPECT_DOUBLE_EQ(params.values()[1], 0.0);
+
+    params.values()[0] = 3.0;
+    params.values()[1] = 4.0;
+    SGD<double> by_value{{.learning_rate = 1.0, .clipping = {.max_value = 7.0}}};
+    by_value.step(params);
+    EXPECT_DOUBLE_EQ(params.values()[0], -3.0);
+    EXPECT_DOUBLE_EQ(params.values()[1], -3.0);
+}
+
+TEST(OptimizerTest, FitsLinearRegression) {
+    // y = 2x + 1 from a handful of points, with a squared-error loss built once.
+    auto a = constant(0.0);
+    auto b = constant(0.0);
+    ExpressionD loss = constant(0.0);
+    for (double x : {-1.0, 0.0, 1.0, 2.0, 3.0}) {
+        auto err = a * x + b + -(2 * x + 1);
+        loss = loss + err * err;
+    }
+    ParameterBuffer<double> params{{a, b}};
+    Adam<double> adam{{.learning_rate = 0.05}};
+    for (int step = 0; step < 2000; ++step) {
+        loss->evaluate();
+        loss->get_gradients();
+        params.gather_grads();
+        adam.step(params);
+    }
+    EXPECT_NEAR(a->value(), 2.0, 1e-4);
+    EXPECT_NEAR(b->value(), 1.0, 1e-4);
+}
+
+TEST(OptimizerTest, SteadyStateStepsDoNotAllocate) {
+    Quadratic model{std::vector<double>(64, 1.0), std::vector<double>(64, 0.0)};
+    ParameterBuffer<double> params{model.weights};
+    SGD<double> sgd{{.clipping = {.max_norm = 1.0}}};
+    Momentum<double> momentum{};
+    Adam<double> adam{};
+    model.backward();
+
+    // First steps size the optimizers' state.
+    params.gather_grads();
+    sgd.step(params);
+    momentum.step(params);
+    adam.step(params);
+
+    const size_t before = allocations.load();
+    for (int step = 0; step < 10; ++step) {
+        params.gather_grads();
+        params.gather_grads(Gather::ACCUMULATE);
+        sgd.step(params);
+        momentum.step(params);
+        adam.step(params);
+    }
+    EXPECT_EQ(allocations.load(), before);
+}